@@ -0,0 +1,122 @@
+/* boottime.c - Boot phase timestamps and command-line options */
+#include "boottime.h"
+#include "cpu.h"
+#include "serial.h"
+#include "string.h"
+#include "timer.h"
+
+/* Stamped by boot.S before and after the BSS clear */
+extern uint64_t boot_tsc_entry;
+extern uint64_t boot_tsc_bss;
+
+typedef struct
+{
+    const char *name;
+    uint64_t end_tsc;
+} boot_stamp_t;
+
+/* [0] is kernel entry; every later entry ends a phase begun by the one before */
+static boot_stamp_t stamps[BOOT_PHASES_MAX];
+static int stamp_count = 0;
+
+static char cmdline[BOOT_CMDLINE_MAX];
+
+static void add_stamp(const char *name, uint64_t tsc)
+{
+    if (stamp_count < BOOT_PHASES_MAX)
+    {
+        stamps[stamp_count].name = name;
+        stamps[stamp_count].end_tsc = tsc;
+        stamp_count++;
+    }
+}
+
+void boottime_init(const multiboot_info_t *mbi)
+{
+    add_stamp("kernel entry", boot_tsc_entry);
+    add_stamp("bss clear", boot_tsc_bss);
+
+    /* Paging is still off, so the loader's string is readable wherever it is */
+    cmdline[0] = '\0';
+    if (mbi != NULL && (mbi->flags & MULTIBOOT_INFO_CMDLINE) && mbi->cmdline != 0)
+    {
+        const char *src = (const char *)mbi->cmdline;
+        int i = 0;
+        while (src[i] && i < BOOT_CMDLINE_MAX - 1)
+        {
+            cmdline[i] = src[i];
+            i++;
+        }
+        cmdline[i] = '\0';
+    }
+}
+
+void boot_phase(const char *name)
+{
+    add_stamp(name, rdtsc());
+}
+
+int boot_option(const char *word)
+{
+    int len = (int)strlen(word);
+    const char *p = cmdline;
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        int n = 0;
+        while (p[n] && p[n] != ' ')
+            n++;
+        if (n == len && n > 0)
+        {
+            int i = 0;
+            while (i < n && p[i] == word[i])
+                i++;
+            if (i == n)
+                return 1;
+        }
+        p += n;
+    }
+    return 0;
+}
+
+const char *boot_cmdline(void)
+{
+    return cmdline;
+}
+
+/* "12.345 ms" */
+static void put_ms(uint64_t cycles)
+{
+    uint64_t ns = timer_tsc_to_ns(cycles);
+    uint32_t ms = timer_ns_to_ms(ns);
+    uint32_t us = (uint32_t)(ns - (uint64_t)ms * 1000000u) / 1000;
+
+    serial_put_dec(ms);
+    serial_putc('.');
+    serial_putc((char)('0' + us / 100));
+    serial_putc((char)('0' + us / 10 % 10));
+    serial_putc((char)('0' + us % 10));
+    serial_puts(" ms");
+}
+
+void boot_print_times(void)
+{
+    serial_puts("Command line: ");
+    serial_puts(cmdline[0] ? cmdline : "(none)");
+    serial_puts("\nReset to kernel entry (firmware and loader): ");
+    put_ms(boot_tsc_entry);
+    serial_puts("\n");
+
+    for (int i = 1; i < stamp_count; i++)
+    {
+        serial_puts("  ");
+        serial_puts(stamps[i].name);
+        for (int pad = (int)strlen(stamps[i].name); pad < 16; pad++)
+            serial_putc(' ');
+        put_ms(stamps[i].end_tsc - stamps[i - 1].end_tsc);
+        serial_puts("  (at ");
+        put_ms(stamps[i].end_tsc - stamps[0].end_tsc);
+        serial_puts(")\n");
+    }
+}
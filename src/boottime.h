@@ -0,0 +1,30 @@
+/* boottime.h - Boot phase timestamps and command-line options */
+#ifndef KACCHI_BOOTTIME_H
+#define KACCHI_BOOTTIME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define BOOT_PHASES_MAX 24
+#define BOOT_CMDLINE_MAX 128
+
+/*
+ * First thing in kmain, before serial_init: keep the loader's command
+ * line ('mbi' may be NULL) and record the entry and BSS-clear stamps
+ * boot.S took. Prints nothing.
+ */
+void boottime_init(const multiboot_info_t *mbi);
+
+/* Close the phase that ran since the previous stamp; 'name' must be static */
+void boot_phase(const char *name);
+
+/* Non-zero if 'word' is one of the space-separated command-line words */
+int boot_option(const char *word);
+
+/* The command line as the loader passed it, "" if none */
+const char *boot_cmdline(void);
+
+/* Time per phase and running total since kernel entry (needs timer_init) */
+void boot_print_times(void);
+
+#endif /* KACCHI_BOOTTIME_H */
@@ -0,0 +1,124 @@
+/* chan.c - Message channels: bounded queues any process can post to */
+#include "chan.h"
+#include "process.h"
+#include "scheduler.h"
+#include "spinlock.h"
+#include "string.h"
+#include "waitset.h"
+
+typedef struct
+{
+    spinlock_t lock;
+    int in_use;
+    int32_t owner; /* creating PID, -1 for the kernel */
+    uint32_t head; /* oldest message */
+    uint32_t count;
+    char msg[CHAN_SLOTS][IPC_MSG_SIZE];
+} chan_t;
+
+static chan_t chans[CHAN_MAX] = {
+    [0 ... CHAN_MAX - 1] = {SPINLOCK_INIT, 0, -1, 0, 0, {{0}}},
+};
+
+static int valid_chan(int32_t id)
+{
+    return id >= 0 && id < CHAN_MAX;
+}
+
+int32_t chan_create(void)
+{
+    int32_t pid = scheduler_current_pid();
+
+    for (int32_t id = 0; id < CHAN_MAX; id++)
+    {
+        chan_t *c = &chans[id];
+        spin_lock(&c->lock);
+        if (!c->in_use)
+        {
+            c->in_use = 1;
+            c->owner = pid;
+            c->head = 0;
+            c->count = 0;
+            spin_unlock(&c->lock);
+            return id;
+        }
+        spin_unlock(&c->lock);
+    }
+    return -1;
+}
+
+int chan_send(int32_t id, const char *msg)
+{
+    if (!valid_chan(id))
+        return -1;
+
+    chan_t *c = &chans[id];
+    spin_lock(&c->lock);
+    if (!c->in_use || c->count == CHAN_SLOTS)
+    {
+        spin_unlock(&c->lock);
+        return -1;
+    }
+
+    char *slot = c->msg[(c->head + c->count) % CHAN_SLOTS];
+    int i = 0;
+    while (msg[i] && i < IPC_MSG_SIZE - 1)
+    {
+        slot[i] = msg[i];
+        i++;
+    }
+    slot[i] = '\0';
+    c->count++;
+    spin_unlock(&c->lock);
+
+    waitset_notify(WS_CHANNEL, id);
+    return 0;
+}
+
+int chan_recv(int32_t id, char *out)
+{
+    if (!valid_chan(id))
+        return -1;
+
+    /* Copy out after unlocking; 'out' may take a copy-on-write fault */
+    char msg[IPC_MSG_SIZE];
+    chan_t *c = &chans[id];
+    spin_lock(&c->lock);
+    if (!c->in_use || c->count == 0)
+    {
+        spin_unlock(&c->lock);
+        return -1;
+    }
+    memcpy(msg, c->msg[c->head], IPC_MSG_SIZE);
+    c->head = (c->head + 1) % CHAN_SLOTS;
+    c->count--;
+    spin_unlock(&c->lock);
+
+    memcpy(out, msg, IPC_MSG_SIZE);
+    return 0;
+}
+
+uint32_t chan_pending(int32_t id)
+{
+    if (!valid_chan(id) || !chans[id].in_use)
+        return 0;
+    return chans[id].count;
+}
+
+void chan_release_owner(int32_t pid)
+{
+    for (int32_t id = 0; id < CHAN_MAX; id++)
+    {
+        chan_t *c = &chans[id];
+        if (!c->in_use || c->owner != pid)
+            continue;
+
+        spin_lock(&c->lock);
+        if (c->in_use && c->owner == pid)
+        {
+            c->in_use = 0;
+            c->count = 0;
+        }
+        spin_unlock(&c->lock);
+    }
+}
@@ -0,0 +1,25 @@
+/* chan.h - Message channels: bounded queues any process can post to */
+#ifndef KACCHI_CHAN_H
+#define KACCHI_CHAN_H
+
+#include "types.h"
+
+#define CHAN_MAX 32
+#define CHAN_SLOTS 8 /* messages buffered per channel */
+
+/* New channel owned by the calling process (freed when it exits); -1 if none left */
+int32_t chan_create(void);
+
+/* Queue a copy of 'msg' (truncated to IPC_MSG_SIZE - 1); -1 if full or no such channel */
+int chan_send(int32_t id, const char *msg);
+
+/* Take the oldest message; -1 if empty or no such channel */
+int chan_recv(int32_t id, char *out);
+
+/* Messages waiting on 'id', 0 if there is no such channel */
+uint32_t chan_pending(int32_t id);
+
+/* Free every channel 'pid' created */
+void chan_release_owner(int32_t pid);
+
+#endif /* KACCHI_CHAN_H */
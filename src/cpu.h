@@ -0,0 +1,141 @@
+/* cpu.h - Control registers, TLB and timestamp helpers */
+#ifndef KACCHI_CPU_H
+#define KACCHI_CPU_H
+
+#include "types.h"
+
+#define CR0_MP (1u << 1)
+#define CR0_EM (1u << 2)
+#define CR0_TS (1u << 3)
+#define CR0_NE (1u << 5)
+#define CR0_WP (1u << 16)
+#define CR0_PG (1u << 31)
+#define CR4_PSE (1u << 4)
+#define CR4_PGE (1u << 7)
+#define CR4_OSFXSR (1u << 9)
+#define CR4_OSXMMEXCPT (1u << 10)
+
+/* SYSENTER target selector, stack and entry point */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* Local APIC physical base (bits 12-31) and global enable (bit 11) */
+#define MSR_APIC_BASE 0x1B
+
+/* Absolute TSC value at which the APIC timer fires (TSC-deadline mode) */
+#define MSR_TSC_DEADLINE 0x6E0
+
+#define CPUID_ECX_TSC_DEADLINE (1u << 24)
+
+#define CPUID_EDX_FPU (1u << 0)
+#define CPUID_EDX_APIC (1u << 9)
+#define CPUID_EDX_SEP (1u << 11)
+#define CPUID_EDX_CLFSH (1u << 19)
+#define CPUID_EDX_FXSR (1u << 24)
+#define CPUID_EDX_SSE (1u << 25)
+
+static inline uint32_t read_cr0(void)
+{
+    uint32_t val;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr0(uint32_t val)
+{
+    __asm__ volatile("mov %0, %%cr0" : : "r"(val) : "memory");
+}
+
+static inline uint32_t read_cr2(void)
+{
+    uint32_t val;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(val));
+    return val;
+}
+
+static inline uint32_t read_cr3(void)
+{
+    uint32_t val;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr3(uint32_t val)
+{
+    __asm__ volatile("mov %0, %%cr3" : : "r"(val) : "memory");
+}
+
+static inline uint32_t read_cr4(void)
+{
+    uint32_t val;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr4(uint32_t val)
+{
+    __asm__ volatile("mov %0, %%cr4" : : "r"(val) : "memory");
+}
+
+/* Clear CR0.TS: FPU instructions stop trapping */
+static inline void clts(void)
+{
+    __asm__ volatile("clts");
+}
+
+static inline void invlpg(uint32_t addr)
+{
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/* Write back and evict the cache line holding 'p' (CPUID_EDX_CLFSH) */
+static inline void clflush(const volatile void *p)
+{
+    __asm__ volatile("clflush (%0)" : : "r"(p) : "memory");
+}
+
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val)
+{
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)val), "d"((uint32_t)(val >> 32)));
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
+{
+    __asm__ volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+/* Let maskable interrupts in (kernel code no longer runs with IF clear) */
+static inline void cpu_irq_enable(void)
+{
+    __asm__ volatile("sti" ::: "memory");
+}
+
+static inline void cpu_irq_disable(void)
+{
+    __asm__ volatile("cli" ::: "memory");
+}
+
+static inline void cpu_halt(void)
+{
+    while (1)
+    {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+#endif /* KACCHI_CPU_H */
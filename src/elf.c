@@ -0,0 +1,94 @@
+/* elf.c - ELF32 executables loaded into process address spaces */
+#include "elf.h"
+#include "paging.h"
+#include "string.h"
+
+static int header_ok(const elf32_ehdr_t *eh, uint32_t size)
+{
+    if (size < sizeof(elf32_ehdr_t))
+        return 0;
+    if (eh->magic != ELF_MAGIC || eh->class != ELF_CLASS_32 || eh->data != ELF_DATA_LSB ||
+        eh->type != ELF_TYPE_EXEC || eh->machine != ELF_MACHINE_386)
+        return 0;
+    if (eh->phentsize != sizeof(elf32_phdr_t) || eh->phnum == 0)
+        return 0;
+    return eh->phoff <= size && (size - eh->phoff) / sizeof(elf32_phdr_t) >= eh->phnum;
+}
+
+static int segment_ok(const elf32_phdr_t *ph, uint32_t size)
+{
+    if (ph->filesz > ph->memsz || ph->offset > size || ph->filesz > size - ph->offset)
+        return 0;
+    if (ph->vaddr < ELF_USER_BASE || ph->memsz > ELF_USER_END - ph->vaddr)
+        return 0;
+    /* File and memory agree on the page offset, as the ELF spec demands */
+    return ((ph->offset ^ ph->vaddr) & ~PTE_FRAME) == 0;
+}
+
+/* Map one segment page by page, sharing or copying each one */
+static int load_segment(uint32_t *dir, const uint8_t *image, const elf32_phdr_t *ph, int share)
+{
+    uint32_t start = ph->vaddr & PTE_FRAME;
+    uint32_t file_end = ph->vaddr + ph->filesz;
+    uint32_t end = ph->vaddr + ph->memsz;
+    int writable = (ph->flags & ELF_PF_W) != 0;
+    uint32_t flags = PTE_USER | (writable ? PTE_WRITE : 0);
+
+    for (uint32_t va = start; va < end; va += PAGE_SIZE)
+    {
+        if (paging_lookup(dir, va) != 0)
+            return -1; /* two segments in one page */
+
+        /* Read-only text and constants: map the image itself, no copy */
+        if (share && !writable && (va + PAGE_SIZE <= file_end || ph->memsz == ph->filesz))
+        {
+            uint32_t pa = (uint32_t)image + ph->offset - (ph->vaddr - va);
+            if (paging_map(dir, va, pa, flags) != 0)
+                return -1;
+            continue;
+        }
+
+        uint32_t frame = frame_alloc();
+        if (frame == 0)
+            return -1;
+        if (paging_map(dir, va, frame, flags) != 0)
+        {
+            frame_free(frame);
+            return -1;
+        }
+
+        /* The part of [vaddr, file_end) in this page; the rest stays zero */
+        uint32_t from = va < ph->vaddr ? ph->vaddr : va;
+        uint32_t to = va + PAGE_SIZE < file_end ? va + PAGE_SIZE : file_end;
+        if (from < to)
+            memcpy((void *)(frame + (from - va)), image + ph->offset + (from - ph->vaddr), to - from);
+    }
+    return 0;
+}
+
+int elf_load(uint32_t *dir, const void *image, uint32_t size, uint32_t *entry)
+{
+    const elf32_ehdr_t *eh = image;
+    if (!header_ok(eh, size))
+        return -1;
+
+    /* Frames can only be shared if file pages are frame pages */
+    int share = ((uint32_t)image & ~PTE_FRAME) == 0;
+
+    const elf32_phdr_t *ph = (const elf32_phdr_t *)((const uint8_t *)image + eh->phoff);
+    int entry_ok = 0;
+    for (uint32_t i = 0; i < eh->phnum; i++)
+    {
+        if (ph[i].type != ELF_PT_LOAD || ph[i].memsz == 0)
+            continue;
+        if (!segment_ok(&ph[i], size) || load_segment(dir, image, &ph[i], share) != 0)
+            return -1;
+        if (eh->entry >= ph[i].vaddr && eh->entry - ph[i].vaddr < ph[i].memsz)
+            entry_ok = 1;
+    }
+    if (!entry_ok)
+        return -1;
+
+    *entry = eh->entry;
+    return 0;
+}
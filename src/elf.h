@@ -0,0 +1,68 @@
+/* elf.h - ELF32 executables loaded into process address spaces */
+#ifndef KACCHI_ELF_H
+#define KACCHI_ELF_H
+
+#include "types.h"
+
+#define ELF_MAGIC 0x464C457Fu /* "\x7F" "ELF", read as a little-endian word */
+#define ELF_CLASS_32 1
+#define ELF_DATA_LSB 1
+#define ELF_TYPE_EXEC 2
+#define ELF_MACHINE_386 3
+
+#define ELF_PT_LOAD 1
+#define ELF_PF_W 0x2u
+
+/*
+ * Where program segments may go: above the shared identity map and
+ * below the ramfs window, so they never meet the kernel, a file
+ * mapping or the stacks.
+ */
+#define ELF_USER_BASE 0x08000000u
+#define ELF_USER_END 0x40000000u
+
+typedef struct
+{
+    uint32_t magic;
+    uint8_t class;
+    uint8_t data;
+    uint8_t ident_version;
+    uint8_t ident_pad[9];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_ehdr_t;
+
+typedef struct
+{
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf32_phdr_t;
+
+/*
+ * Map the PT_LOAD segments of the executable at 'image' into 'dir' and
+ * store its entry point. Read-only pages map the image's own frames
+ * (page-aligned boot modules are never freed), so every instance shares
+ * one copy; writable and zero-filled pages get private frames. On
+ * failure returns -1 and leaves whatever was mapped for the caller to
+ * destroy with the space.
+ */
+int elf_load(uint32_t *dir, const void *image, uint32_t size, uint32_t *entry);
+
+#endif /* KACCHI_ELF_H */
@@ -0,0 +1,331 @@
+/* fpu.c - Lazy x87/SSE state switching */
+#include "fpu.h"
+#include "cpu.h"
+#include "idt.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "string.h"
+
+#define VEC_NM 7  /* device not available */
+#define VEC_MF 16 /* x87 floating-point error */
+#define VEC_XM 19 /* SIMD floating-point error */
+
+#define MXCSR_DEFAULT 0x1F80 /* all SIMD exceptions masked, round to nearest */
+
+#define FPU_POOL_MAX 4        /* save areas kept for reuse after their process exits */
+#define FPU_SHRINK_PRIORITY 10 /* cheap to give back: a miss is one aligned alloc */
+
+/*
+ * Per-CPU view of the FPU registers. They hold 'owner's state only while
+ * that process's pcb->fpu_cpu still names this CPU: running anywhere
+ * else since then makes the copy here stale.
+ */
+typedef struct
+{
+    int32_t owner; /* last process whose state was loaded here, -1 if none */
+    int used;      /* the running process has touched the FPU this time slice */
+} fpu_cpu_t;
+
+static fpu_cpu_t fpu_cpus[MAX_CPUS];
+
+/* FXSAVE/FXRSTOR and SSE are usable (CR4.OSFXSR set) */
+static int fpu_ready = 0;
+static int sse_ready = 0;
+
+static volatile uint32_t areas_allocated = 0;
+
+/* Areas of exited processes, handed to the next process that needs one */
+static void *area_pool[FPU_POOL_MAX];
+static int area_pooled = 0;
+static spinlock_t pool_lock = SPINLOCK_INIT;
+
+static inline void stts(void)
+{
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+static inline void fxsave(void *area)
+{
+    __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void fxrstor(const void *area)
+{
+    __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+/* A save area from the pool, else the heap; NULL if both are out */
+static void *area_get(void)
+{
+    void *area = NULL;
+
+    spin_lock(&pool_lock);
+    if (area_pooled > 0)
+        area = area_pool[--area_pooled];
+    spin_unlock(&pool_lock);
+
+    if (area == NULL)
+    {
+        /* Out of ring 3's reach: paging_init() checks the heap is supervisor-only */
+        area = heap_alloc_aligned(FPU_STATE_SIZE, FPU_STATE_ALIGN);
+        if (area == NULL)
+            return NULL;
+    }
+    __atomic_add_fetch(&areas_allocated, 1, __ATOMIC_RELAXED);
+    return area;
+}
+
+static void area_put(void *area)
+{
+    spin_lock(&pool_lock);
+    if (area_pooled < FPU_POOL_MAX)
+    {
+        area_pool[area_pooled++] = area;
+        area = NULL;
+    }
+    spin_unlock(&pool_lock);
+
+    if (area)
+        heap_free(area);
+}
+
+/* Shrinker: pooled areas go back to the heap */
+static size_t shrink_area_pool(size_t want)
+{
+    size_t freed = 0;
+
+    while (freed < want)
+    {
+        void *area = NULL;
+        spin_lock(&pool_lock);
+        if (area_pooled > 0)
+            area = area_pool[--area_pooled];
+        spin_unlock(&pool_lock);
+        if (area == NULL)
+            break;
+
+        heap_free(area);
+        freed += FPU_STATE_SIZE;
+    }
+    return freed;
+}
+
+/* Fresh state for a process's first FPU instruction */
+static void fpu_reset(void)
+{
+    __asm__ volatile("fninit");
+    if (sse_ready)
+    {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        __asm__ volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+}
+
+/* ---------------------------------------------------
+ * #NM: the running process used the FPU with CR0.TS set
+ * --------------------------------------------------- */
+static void fpu_trap(isr_frame_t *frame)
+{
+    int cpu = smp_cpu_id();
+    int32_t pid = scheduler_current_pid();
+
+    if (pid < 0 || !(frame->cs & 3))
+    {
+        serial_puts("\n[PANIC] FPU used by kernel code outside fpu_kernel_begin() at EIP ");
+        serial_put_hex(frame->eip);
+        serial_puts("\n");
+        cpu_halt();
+    }
+
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (!fpu_ready)
+    {
+        serial_puts("\n[Fault] PID ");
+        serial_put_dec((uint32_t)pid);
+        serial_puts(": FPU instruction on a CPU without FXSAVE - terminating\n");
+        scheduler_exit();
+    }
+
+    clts();
+    fpu_cpus[cpu].used = 1;
+
+    /* Nobody else loaded state here since this process last ran on this CPU */
+    if (fpu_cpus[cpu].owner == pid && pcb->fpu_cpu == cpu)
+        return;
+
+    if (pcb->fpu_state == NULL)
+    {
+        void *area = area_get();
+        if (area == NULL)
+        {
+            fpu_cpus[cpu].used = 0;
+            stts();
+            serial_puts("\n[Fault] PID ");
+            serial_put_dec((uint32_t)pid);
+            serial_puts(": no memory for FPU state - terminating\n");
+            scheduler_exit();
+        }
+        pcb->fpu_state = area;
+        fpu_reset();
+    }
+    else
+    {
+        fxrstor(pcb->fpu_state);
+    }
+
+    fpu_cpus[cpu].owner = pid;
+    pcb->fpu_cpu = cpu;
+}
+
+/* #MF / #XM: an exception the process unmasked itself */
+static void fpu_error(isr_frame_t *frame)
+{
+    int32_t pid = scheduler_current_pid();
+
+    if (pid < 0 || !(frame->cs & 3))
+    {
+        serial_puts("\n[PANIC] FPU exception in kernel at EIP ");
+        serial_put_hex(frame->eip);
+        serial_puts("\n");
+        cpu_halt();
+    }
+
+    serial_puts("\n[Fault] PID ");
+    serial_put_dec((uint32_t)pid);
+    serial_puts(frame->vector == VEC_MF ? ": x87" : ": SIMD");
+    serial_puts(" floating-point exception at EIP ");
+    serial_put_hex(frame->eip);
+    serial_puts(" - terminating\n");
+    scheduler_exit();
+}
+
+int fpu_init_cpu(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+
+    int cpu = smp_cpu_id();
+    fpu_cpus[cpu].owner = -1;
+    fpu_cpus[cpu].used = 0;
+
+    if (!(d & CPUID_EDX_FPU) || !(d & CPUID_EDX_FXSR))
+    {
+        /* Leave EM set: every FPU instruction reaches fpu_trap() */
+        write_cr0(read_cr0() | CR0_EM | CR0_TS);
+        return -1;
+    }
+
+    /* Native error reporting (#MF), WAIT honours TS, no emulation */
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+
+    uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+    if (d & CPUID_EDX_SSE)
+        cr4 |= CR4_OSXMMEXCPT;
+    write_cr4(cr4);
+
+    __asm__ volatile("fninit");
+    stts();
+    return 0;
+}
+
+void fpu_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+
+    heap_register_shrinker("fpu area pool", FPU_SHRINK_PRIORITY, shrink_area_pool);
+    idt_set_handler(VEC_NM, fpu_trap);
+    idt_set_handler(VEC_MF, fpu_error);
+    idt_set_handler(VEC_XM, fpu_error);
+
+    if (fpu_init_cpu() != 0)
+    {
+        serial_puts("[FPU] No FXSAVE support, processes may not use the FPU\n");
+        return;
+    }
+    fpu_ready = 1;
+    sse_ready = (d & CPUID_EDX_SSE) != 0;
+}
+
+void fpu_switch_in(int32_t pid)
+{
+    (void)pid;
+    fpu_cpus[smp_cpu_id()].used = 0;
+    stts();
+}
+
+void fpu_switch_out(int32_t pid)
+{
+    fpu_cpu_t *self = &fpu_cpus[smp_cpu_id()];
+    if (!self->used)
+        return; /* TS is still set: nothing was loaded */
+
+    /* The registers stay valid too: running it here again needs no restore */
+    fxsave(proc_get_pcb(pid)->fpu_state);
+    self->used = 0;
+    stts();
+}
+
+int fpu_fork(int32_t parent, int32_t child)
+{
+    pcb_t *from = proc_get_pcb(parent);
+    pcb_t *to = proc_get_pcb(child);
+
+    to->fpu_state = NULL;
+    to->fpu_cpu = -1;
+    if (from->fpu_state == NULL)
+        return 0;
+
+    /* Live registers are newer than the save area */
+    fpu_cpu_t *self = &fpu_cpus[smp_cpu_id()];
+    if (self->used && self->owner == parent)
+        fxsave(from->fpu_state);
+
+    void *area = area_get();
+    if (area == NULL)
+        return -1;
+    memcpy(area, from->fpu_state, FPU_STATE_SIZE);
+    to->fpu_state = area;
+    return 0;
+}
+
+void fpu_release(int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (pcb == NULL || pcb->fpu_state == NULL)
+        return;
+
+    /* With fpu_cpu cleared no CPU can mistake its registers for live state */
+    pcb->fpu_cpu = -1;
+    area_put(pcb->fpu_state);
+    pcb->fpu_state = NULL;
+}
+
+void fpu_kernel_begin(void)
+{
+    fpu_cpu_t *self = &fpu_cpus[smp_cpu_id()];
+    int32_t pid = scheduler_current_pid();
+
+    if (self->used && self->owner == pid)
+        fxsave(proc_get_pcb(pid)->fpu_state);
+
+    /* The registers are about to hold kernel values; the next #NM restores */
+    self->owner = -1;
+    self->used = 0;
+    clts();
+    fpu_reset();
+}
+
+void fpu_kernel_end(void)
+{
+    stts();
+}
+
+uint32_t fpu_area_count(void)
+{
+    return areas_allocated;
+}
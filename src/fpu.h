@@ -0,0 +1,46 @@
+/* fpu.h - Lazy x87/SSE state switching */
+#ifndef KACCHI_FPU_H
+#define KACCHI_FPU_H
+
+#include "types.h"
+
+/* FXSAVE image: 512 bytes, must be 16-byte aligned */
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_ALIGN 16
+
+/*
+ * Enable the x87 and SSE units on the boot CPU and install the #NM
+ * handler. Processes get a save area on their first FPU instruction;
+ * the rest never pay for one.
+ */
+void fpu_init(void);
+
+/* Same CR0/CR4 setup on an AP; -1 if it lacks FXSAVE. */
+int fpu_init_cpu(void);
+
+/*
+ * Scheduler hooks around a process's time on this CPU. Switching in
+ * sets CR0.TS so the first FPU instruction traps; switching out saves
+ * the registers only if that happened.
+ */
+void fpu_switch_in(int32_t pid);
+void fpu_switch_out(int32_t pid);
+
+/* Give the child of a fork its own copy of the parent's state; -1 if out of memory. */
+int fpu_fork(int32_t parent, int32_t child);
+
+/* Drop a terminating process's state and save area. */
+void fpu_release(int32_t pid);
+
+/*
+ * Bracket kernel code that uses x87/SSE instructions. The current
+ * process's live state is saved first, and kernel code must not yield
+ * in between.
+ */
+void fpu_kernel_begin(void);
+void fpu_kernel_end(void);
+
+/* Processes that have needed a save area so far */
+uint32_t fpu_area_count(void);
+
+#endif /* KACCHI_FPU_H */
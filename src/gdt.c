@@ -0,0 +1,102 @@
+/* gdt.c - Flat ring 0/3 segments plus the TSSs used for traps and faults */
+#include "gdt.h"
+
+#define GDT_ENTRIES (GDT_TSS / 8 + MAX_CPUS)
+
+typedef struct __attribute__((packed))
+{
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t flags_limit; /* granularity/size flags in the high nibble */
+    uint8_t base_high;
+} gdt_entry_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t limit;
+    uint32_t base;
+} gdt_ptr_t;
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static tss_t cpu_tss[MAX_CPUS];
+static tss_t fault_tss;
+
+static void gdt_set(int index, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags)
+{
+    gdt[index].limit_low = limit & 0xFFFF;
+    gdt[index].base_low = base & 0xFFFF;
+    gdt[index].base_mid = (base >> 16) & 0xFF;
+    gdt[index].access = access;
+    gdt[index].flags_limit = (flags & 0xF0) | ((limit >> 16) & 0x0F);
+    gdt[index].base_high = (base >> 24) & 0xFF;
+}
+
+void gdt_init(void)
+{
+    gdt_set(0, 0, 0, 0, 0);
+    gdt_set(GDT_KCODE >> 3, 0, 0xFFFFF, 0x9A, 0xC0); /* ring 0 code, 4 KB gran */
+    gdt_set(GDT_KDATA >> 3, 0, 0xFFFFF, 0x92, 0xC0); /* ring 0 data */
+    gdt_set(GDT_UCODE >> 3, 0, 0xFFFFF, 0xFA, 0xC0); /* ring 3 code */
+    gdt_set(GDT_UDATA >> 3, 0, 0xFFFFF, 0xF2, 0xC0); /* ring 3 data */
+    gdt_set(GDT_FAULT_TSS >> 3, (uint32_t)&fault_tss, sizeof(tss_t) - 1, 0x89, 0x00);
+    fault_tss.iomap_base = sizeof(tss_t);
+
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        gdt_set((GDT_TSS >> 3) + cpu, (uint32_t)&cpu_tss[cpu], sizeof(tss_t) - 1, 0x89, 0x00);
+        cpu_tss[cpu].ss0 = GDT_KDATA;
+        cpu_tss[cpu].iomap_base = sizeof(tss_t);
+    }
+
+    gdt_load(0);
+}
+
+void gdt_load(int cpu)
+{
+    gdt_ptr_t ptr = {sizeof(gdt) - 1, (uint32_t)gdt};
+
+    __asm__ volatile(
+        "lgdt %0\n\t"
+        "ljmp %1, $1f\n"
+        "1:\n\t"
+        "mov %2, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%fs\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        "mov %3, %%ax\n\t"
+        "ltr %%ax"
+        :
+        : "m"(ptr), "i"(GDT_KCODE), "i"(GDT_KDATA), "r"((uint16_t)(GDT_TSS + 8 * cpu))
+        : "eax", "memory");
+}
+
+tss_t *gdt_faulted_tss(void)
+{
+    return &cpu_tss[(fault_tss.link - GDT_TSS) / 8];
+}
+
+void gdt_set_kernel_stack(uint32_t esp0)
+{
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        cpu_tss[cpu].esp0 = esp0;
+    }
+}
+
+void gdt_set_fault_task(void (*entry)(void), void *stack_top, uint32_t cr3)
+{
+    fault_tss.eip = (uint32_t)entry;
+    fault_tss.esp = (uint32_t)stack_top;
+    fault_tss.cr3 = cr3;
+    fault_tss.eflags = 0x2; /* reserved bit; interrupts stay off */
+    fault_tss.cs = GDT_KCODE;
+    fault_tss.ss = GDT_KDATA;
+    fault_tss.ds = GDT_KDATA;
+    fault_tss.es = GDT_KDATA;
+    fault_tss.fs = GDT_KDATA;
+    fault_tss.gs = GDT_KDATA;
+}
@@ -0,0 +1,58 @@
+/* gdt.h - Segment descriptors and task state segments */
+#ifndef KACCHI_GDT_H
+#define KACCHI_GDT_H
+
+#include "types.h"
+
+/*
+ * Selectors. SYSENTER/SYSEXIT derive every segment from GDT_KCODE, so
+ * kernel code/data and user code/data must stay in this order.
+ */
+#define GDT_KCODE 0x08
+#define GDT_KDATA 0x10
+#define GDT_UCODE 0x18
+#define GDT_UDATA 0x20
+#define GDT_FAULT_TSS 0x28 /* double-fault handler task (runs on its own stack) */
+#define GDT_TSS 0x30       /* CPU 0's task; CPU n uses GDT_TSS + 8 * n */
+
+/* Upper bound on CPUs brought online (one TSS descriptor each) */
+#define MAX_CPUS 8
+
+/* Ring-3 selectors as loaded into CS / DS / SS */
+#define USER_CS (GDT_UCODE | 3)
+#define USER_DS (GDT_UDATA | 3)
+
+/* 32-bit hardware task state segment */
+typedef struct __attribute__((packed))
+{
+    uint32_t link;
+    uint32_t esp0, ss0;
+    uint32_t esp1, ss1;
+    uint32_t esp2, ss2;
+    uint32_t cr3;
+    uint32_t eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap, iomap_base;
+} tss_t;
+
+/* Build the kernel GDT and load it on the boot CPU (gdt_load(0)). */
+void gdt_init(void);
+
+/* Load the GDT, reload segment registers and take CPU 'cpu''s TSS. */
+void gdt_load(int cpu);
+
+/*
+ * The TSS the fault task interrupted (from its back link): that CPU's
+ * context at the time of the fault has been saved there.
+ */
+tss_t *gdt_faulted_tss(void);
+
+/* Stack every CPU switches to on an interrupt or trap out of ring 3. */
+void gdt_set_kernel_stack(uint32_t esp0);
+
+/* Give the fault task its entry point, stack and address space. */
+void gdt_set_fault_task(void (*entry)(void), void *stack_top, uint32_t cr3);
+
+#endif /* KACCHI_GDT_H */
@@ -0,0 +1,106 @@
+/* idt.c - Interrupt descriptor table and exception dispatch */
+#include "idt.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "serial.h"
+
+typedef struct __attribute__((packed))
+{
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} idt_entry_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t limit;
+    uint32_t base;
+} idt_ptr_t;
+
+#define IDT_INT_GATE 0x8E  /* present, ring 0, 32-bit interrupt gate */
+#define IDT_USER_GATE 0xEF /* present, ring 3, 32-bit trap gate */
+#define IDT_TASK_GATE 0x85 /* present, ring 0, task gate */
+
+static idt_entry_t idt[IDT_ENTRIES];
+static isr_handler_t handlers[IDT_ENTRIES];
+
+/* Stub addresses for exceptions 0-31 (isr.S) */
+extern const uint32_t isr_stub_table[32];
+
+static const char *const exception_names[32] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "BOUND range", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor overrun", "Invalid TSS",
+    "Segment not present", "Stack fault", "General protection",
+    "Page fault", "Reserved", "x87 FP error", "Alignment check",
+    "Machine check", "SIMD FP error", "Virtualization", "Control protection",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Hypervisor injection", "VMM communication", "Security", "Reserved"};
+
+static void idt_set_gate(uint8_t vector, uint32_t offset, uint16_t selector, uint8_t type_attr)
+{
+    idt[vector].offset_low = offset & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = type_attr;
+    idt[vector].offset_high = (offset >> 16) & 0xFFFF;
+}
+
+void idt_init(void)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        idt_set_gate(i, isr_stub_table[i], GDT_KCODE, IDT_INT_GATE);
+    }
+
+    idt_load();
+}
+
+void idt_load(void)
+{
+    idt_ptr_t ptr = {sizeof(idt) - 1, (uint32_t)idt};
+    __asm__ volatile("lidt %0" : : "m"(ptr));
+}
+
+void idt_set_handler(uint8_t vector, isr_handler_t handler)
+{
+    handlers[vector] = handler;
+}
+
+void idt_set_user_gate(uint8_t vector, void (*stub)(void))
+{
+    idt_set_gate(vector, (uint32_t)stub, GDT_KCODE, IDT_USER_GATE);
+}
+
+void idt_set_irq_gate(uint8_t vector, void (*stub)(void))
+{
+    idt_set_gate(vector, (uint32_t)stub, GDT_KCODE, IDT_INT_GATE);
+}
+
+void idt_set_task_gate(uint8_t vector, uint16_t tss_selector)
+{
+    idt_set_gate(vector, 0, tss_selector, IDT_TASK_GATE);
+}
+
+/* Common C entry for every stub in isr.S */
+void isr_dispatch(isr_frame_t *frame)
+{
+    if (handlers[frame->vector])
+    {
+        handlers[frame->vector](frame);
+        return;
+    }
+
+    serial_puts("\n[PANIC] ");
+    serial_puts(frame->vector < 32 ? exception_names[frame->vector] : "Unexpected interrupt");
+    serial_puts(" (vector ");
+    serial_put_dec(frame->vector);
+    serial_puts(", error ");
+    serial_put_hex(frame->error);
+    serial_puts(") at EIP ");
+    serial_put_hex(frame->eip);
+    serial_puts("\n");
+    cpu_halt();
+}
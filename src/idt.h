@@ -0,0 +1,42 @@
+/* idt.h - Interrupt descriptor table and exception dispatch */
+#ifndef KACCHI_IDT_H
+#define KACCHI_IDT_H
+
+#include "types.h"
+
+#define IDT_ENTRIES 256
+
+/* Register snapshot pushed by the stubs in isr.S */
+typedef struct
+{
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp_unused, ebx, edx, ecx, eax; /* pusha */
+    uint32_t vector, error;
+    uint32_t eip, cs, eflags;
+    uint32_t user_esp, user_ss; /* only valid after a privilege change */
+} isr_frame_t;
+
+typedef void (*isr_handler_t)(isr_frame_t *frame);
+
+/* Build and load the IDT; every CPU exception panics unless overridden. */
+void idt_init(void);
+
+/* Load the (shared) IDT on the calling CPU. */
+void idt_load(void);
+
+/* Route 'vector' to 'handler' (stub must exist: exceptions 0-31, 0x40, 0x41, 0x80, 0xFF). */
+void idt_set_handler(uint8_t vector, isr_handler_t handler);
+
+/*
+ * Route 'vector' to 'stub' through a gate ring 3 may invoke with int.
+ * It is a trap gate: system calls run with interrupts enabled.
+ */
+void idt_set_user_gate(uint8_t vector, void (*stub)(void));
+
+/* Route a device interrupt 'vector' to 'stub' (ring 0 only, IF cleared). */
+void idt_set_irq_gate(uint8_t vector, void (*stub)(void));
+
+/* Deliver 'vector' through a task gate to the TSS at 'tss_selector'. */
+void idt_set_task_gate(uint8_t vector, uint16_t tss_selector);
+
+#endif /* KACCHI_IDT_H */
@@ -5,28 +5,480 @@
 #include "memory.h"
 #include "process.h"
 #include "scheduler.h"
+#include "gdt.h"
+#include "idt.h"
+#include "paging.h"
+#include "syscall.h"
+#include "usys.h"
+#include "cpu.h"
+#include "smp.h"
+#include "fpu.h"
+#include "prof.h"
+#include "timer.h"
+#include "trace.h"
+#include "sync.h"
+#include "workq.h"
+#include "task.h"
+#include "multiboot.h"
+#include "ramfs.h"
+#include "boottime.h"
 
 #define MAX_INPUT 128
+#define SHELL_MAX_ALLOCS 16
+#define SYSCALL_BENCH_ROUNDS 10000
+#define SMP_BENCH_WORKERS 8
+#define SMP_BENCH_SLICES 200
+#define SMP_BENCH_SLICE_WORK 20000
+#define FPU_TEST_ROUNDS 4
+#define SLEEP_TEST_PROCS 3
+#define SLEEP_TEST_BASE_MS 100
+#define MUTEX_TEST_PROCS 4
+#define MUTEX_TEST_ROUNDS 50
+#define SELECT_TEST_PEERS 3 /* the last one posts to the mailbox, the rest to channels */
+#define SELECT_TEST_MSGS 10
+#define SELECT_TEST_TICK_MS 50
+#define TASKS_TEST_CLIENTS 10000
+#define TASKS_TEST_ROUNDS 2
+#define TASKS_TEST_SPREAD_MS 50
+#define TASKS_TEST_STACK (512 * 1024) /* the task array lives on it */
+#define WORKQ_TEST_PROCS 4
+#define WORKQ_TEST_FREES 64
+#define EDF_TEST_JOBS 25
+#define EDF_TEST_BULK 2
+#define EDF_TEST_JOB_WORK 20000
+
+/* Blocks handed out by the shell's 'alloc', released LIFO by 'free' */
+static void *shell_allocs[SHELL_MAX_ALLOCS];
+static int shell_alloc_count = 0;
 
 /* ================================================================
- * TEST PROCESSES
+ * TEST PROCESSES (ring 3: system calls only, see usys.h)
  * ================================================================ */
 void test_proc_hello(void)
 {
-    serial_puts("    [P] Hello from process!\n");
+    sys_puts("    [P] Hello from process!\n");
 }
 
 void test_proc_count(void)
 {
-    serial_puts("    [P] Counting: 1 2 3\n");
+    sys_puts("    [P] Counting: 1 2 3\n");
 }
 
 void test_proc_mem(void)
 {
-    serial_puts("    [P] Testing heap allocation\n");
-    void *ptr = heap_alloc(256);
+    sys_puts("    [P] Testing heap allocation\n");
+    void *ptr = sys_heap_alloc(256);
     if (ptr)
-        serial_puts("    [P] Success!\n");
+        sys_puts("    [P] Success!\n");
+
+    sys_puts("    [P] Testing arena allocation\n");
+    int ok = 1;
+    for (int i = 0; i < 16; i++)
+    {
+        if (sys_proc_alloc(24) == NULL)
+            ok = 0;
+    }
+    if (ok)
+        sys_puts("    [P] 16 objects from arena, released on exit\n");
+}
+
+void test_proc_fork(void)
+{
+    int value = 1;
+    int32_t child = sys_fork();
+
+    if (child == 0)
+    {
+        value = 2; /* lands in the child's private copy of the page */
+        sys_puts("    [P] Fork child: value = ");
+        sys_put_dec(value);
+        sys_puts("\n");
+    }
+    else if (child > 0)
+    {
+        sys_puts("    [P] Fork parent: child PID ");
+        sys_put_dec(child);
+        sys_puts(", value = ");
+        sys_put_dec(value);
+        sys_puts("\n");
+    }
+    else
+        sys_puts("    [P] Fork failed\n");
+}
+
+/* Average cycles per null system call on each entry path */
+void test_proc_syscall_bench(void)
+{
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < SYSCALL_BENCH_ROUNDS; i++)
+        sys_null();
+    uint64_t t1 = rdtsc();
+    for (int i = 0; i < SYSCALL_BENCH_ROUNDS; i++)
+        sys_null_int80();
+    uint64_t t2 = rdtsc();
+
+    sys_puts("    [P] Null syscall, SYSENTER/SYSEXIT: ");
+    sys_put_dec((uint32_t)(t1 - t0) / SYSCALL_BENCH_ROUNDS);
+    sys_puts(" cycles\n");
+    sys_puts("    [P] Null syscall, int 0x80/iret:    ");
+    sys_put_dec((uint32_t)(t2 - t1) / SYSCALL_BENCH_ROUNDS);
+    sys_puts(" cycles\n");
+}
+
+/* CPU-bound worker for 'smpbench': fixed work, split into yield slices */
+void test_proc_spin(void)
+{
+    uint32_t x = (uint32_t)sys_getpid();
+    for (int slice = 0; slice < SMP_BENCH_SLICES; slice++)
+    {
+        for (int i = 0; i < SMP_BENCH_SLICE_WORK; i++)
+            x = x * 1664525u + 1013904223u;
+        sys_yield();
+    }
+    if (x == 0)
+        sys_puts("    [P] (unlikely)\n"); /* keeps the loop from being optimized out */
+}
+
+/*
+ * Keep a value on the x87 stack and a private rounding mode across
+ * yields. The value is loaded and stored in the same asm statement as
+ * the int 0x80 that yields, so only the lazy FPU switch can preserve it.
+ */
+void test_proc_fpu(void)
+{
+    int32_t pid = sys_getpid();
+    uint16_t cw = (uint16_t)(0x037F | ((pid & 1) ? 0x0400 : 0x0800)); /* round down / up */
+    uint16_t cw_now = 0;
+    int32_t in = pid * 1000;
+    int ok = 1;
+
+    __asm__ volatile("fldcw %0" : : "m"(cw));
+    for (int round = 0; round < FPU_TEST_ROUNDS; round++)
+    {
+        int32_t out = 0;
+        uint32_t nr = SYS_YIELD;
+        __asm__ volatile("fildl %2\n\t"
+                         "int $0x80\n\t"
+                         "fistpl %0"
+                         : "=m"(out), "+a"(nr)
+                         : "m"(in)
+                         : "memory", "cc");
+        __asm__ volatile("fnstcw %0" : "=m"(cw_now));
+        if (out != in || cw_now != cw)
+            ok = 0;
+        in++;
+    }
+
+    sys_puts(ok ? "    [P] FPU state survived every switch\n"
+                : "    [P] FPU state corrupted\n");
+}
+
+/* Shared with ring 3: .ushared is the only kernel data processes can write (not zeroed at boot) */
+static struct
+{
+    volatile uint32_t lock;
+    volatile uint32_t counter;
+} mutex_test __attribute__((section(".ushared"), aligned(4)));
+
+/*
+ * Read-modify-write a shared counter with a yield in the middle, so
+ * the other workers find the mutex held and sleep on it.
+ */
+void test_proc_mutex(void)
+{
+    for (int round = 0; round < MUTEX_TEST_ROUNDS; round++)
+    {
+        umutex_lock(&mutex_test.lock);
+        uint32_t value = mutex_test.counter;
+        sys_yield();
+        mutex_test.counter = value + 1;
+        umutex_unlock(&mutex_test.lock);
+    }
+}
+
+/* Peer for 'select': post SELECT_TEST_MSGS at its own pace, then exit */
+static void select_peer(int index, int32_t server, int32_t chan)
+{
+    for (int k = 0; k < SELECT_TEST_MSGS; k++)
+    {
+        sys_sleep(10 * (uint32_t)(index + 1));
+        if (chan < 0)
+            sys_send(server, "ping");
+        else
+        {
+            while (sys_chan_send(chan, "ping") != 0)
+                sys_yield(); /* full: let the server drain it */
+        }
+    }
+}
+
+/*
+ * One server multiplexing channels, its mailbox and a periodic timer
+ * through a single wait set; it forks its own peers.
+ */
+void test_proc_select(void)
+{
+    int32_t server = sys_getpid();
+    int32_t chan[SELECT_TEST_PEERS];
+    int slot_of[SELECT_TEST_PEERS];
+
+    for (int i = 0; i < SELECT_TEST_PEERS; i++)
+    {
+        chan[i] = i == SELECT_TEST_PEERS - 1 ? -1 : sys_chan_create();
+        slot_of[i] = chan[i] < 0 ? sys_ws_add(WS_MAILBOX, server) : sys_ws_add(WS_CHANNEL, chan[i]);
+    }
+    int timer_slot = sys_ws_add(WS_TIMER, SELECT_TEST_TICK_MS);
+
+    for (int i = 0; i < SELECT_TEST_PEERS; i++)
+    {
+        if (sys_fork() == 0)
+        {
+            select_peer(i, server, chan[i]);
+            return;
+        }
+    }
+
+    uint32_t received = 0, waits = 0, ticks = 0;
+    char msg[IPC_MSG_SIZE];
+    while (received < SELECT_TEST_PEERS * SELECT_TEST_MSGS)
+    {
+        int32_t ready[WAITSET_MAX];
+        int n = sys_ws_wait(ready, WAITSET_MAX, WS_FOREVER);
+        waits++;
+        for (int r = 0; r < n; r++)
+        {
+            if (ready[r] == timer_slot)
+            {
+                ticks++;
+                continue;
+            }
+            /* Edge-triggered: drain the source completely */
+            for (int i = 0; i < SELECT_TEST_PEERS; i++)
+            {
+                if (ready[r] != slot_of[i])
+                    continue;
+                while (chan[i] < 0 ? sys_recv(msg) == 0 : sys_chan_recv(chan[i], msg) == 0)
+                    received++;
+            }
+        }
+    }
+
+    sys_puts("    [P] Server got ");
+    sys_put_dec(received);
+    sys_puts(" messages in ");
+    sys_put_dec(waits);
+    sys_puts(" waits (");
+    sys_put_dec(ticks);
+    sys_puts(" timer ticks)\n");
+}
+
+/* Shared by the tasks of 'tasks', on the executor process's stack */
+typedef struct
+{
+    int32_t chan;
+    uint32_t expected;
+    uint32_t received;
+    uint32_t full; /* sends that found the channel full */
+} tasks_test_t;
+
+/* Client task for 'tasks': TASKS_TEST_ROUNDS times, sleep a while and post a message */
+static int task_client(executor_t *ex, task_t *t)
+{
+    tasks_test_t *test = ex->ctx;
+
+    TASK_BEGIN(t);
+    for (t->arg = 0; t->arg < TASKS_TEST_ROUNDS; t->arg++)
+    {
+        TASK_SLEEP(ex, t, 1 + (uint32_t)(t - ex->tasks) % TASKS_TEST_SPREAD_MS);
+        while (sys_chan_send(test->chan, "job") != 0)
+        {
+            test->full++;
+            TASK_SLEEP(ex, t, 1); /* the server drains it meanwhile */
+        }
+    }
+    TASK_END(t);
+}
+
+/* Server task for 'tasks': receive until every client's messages are in */
+static int task_server(executor_t *ex, task_t *t)
+{
+    tasks_test_t *test = ex->ctx;
+    char msg[IPC_MSG_SIZE];
+
+    TASK_BEGIN(t);
+    while (test->received < test->expected)
+    {
+        if (sys_chan_recv(test->chan, msg) == 0)
+            test->received++;
+        else
+            TASK_WAIT_CHAN(ex, t, test->chan);
+    }
+    TASK_END(t);
+}
+
+/* One process running thousands of stackless tasks on its own stack */
+void test_proc_tasks(void)
+{
+    task_t tasks[1 + TASKS_TEST_CLIENTS];
+    executor_t ex;
+    tasks_test_t test = {sys_chan_create(), TASKS_TEST_CLIENTS * TASKS_TEST_ROUNDS, 0, 0};
+
+    if (test.chan < 0)
+    {
+        sys_puts("    [P] No free channel\n");
+        return;
+    }
+
+    executor_init(&ex, tasks, 1 + TASKS_TEST_CLIENTS, &test);
+    task_spawn(&ex, task_server, 0);
+    for (int i = 0; i < TASKS_TEST_CLIENTS; i++)
+        task_spawn(&ex, task_client, 0);
+
+    uint32_t start = sys_uptime();
+    executor_run(&ex);
+
+    sys_puts("    [P] ");
+    sys_put_dec(1 + TASKS_TEST_CLIENTS);
+    sys_puts(" tasks (");
+    sys_put_dec(sizeof(task_t));
+    sys_puts(" bytes each) done in ");
+    sys_put_dec(sys_uptime() - start);
+    sys_puts(" ms: ");
+    sys_put_dec(test.received);
+    sys_puts(" messages, ");
+    sys_put_dec(test.full);
+    sys_puts(" full-channel retries\n    [P] ");
+    sys_put_dec(ex.runs);
+    sys_puts(" task runs in ");
+    sys_put_dec(ex.passes);
+    sys_puts(" passes, ");
+    sys_put_dec(ex.waits);
+    sys_puts(" waits in the wait set\n");
+}
+
+/* 'wc': counts a ramfs file mapped into its address space; the name arrives by mail */
+void test_proc_wc(void)
+{
+    char name[IPC_MSG_SIZE];
+    if (sys_recv(name) != 0)
+    {
+        sys_puts("    [P] No file name in the mailbox\n");
+        return;
+    }
+
+    int fd = sys_fs_open(name);
+    const uint8_t *data = fd >= 0 ? sys_fs_map(fd) : NULL;
+    if (data == NULL)
+    {
+        sys_puts("    [P] Cannot map ");
+        sys_puts(name);
+        sys_puts("\n");
+        return;
+    }
+
+    uint32_t size = sys_fs_size(fd);
+    uint32_t lines = 0, words = 0;
+    int in_word = 0;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        uint8_t c = data[i];
+        if (c == '\n')
+            lines++;
+        if (c == ' ' || c == '\n' || c == '\t' || c == '\r')
+            in_word = 0;
+        else if (!in_word)
+        {
+            in_word = 1;
+            words++;
+        }
+    }
+
+    sys_puts("    [P] ");
+    sys_put_dec(lines);
+    sys_puts(" ");
+    sys_put_dec(words);
+    sys_puts(" ");
+    sys_put_dec(size);
+    sys_puts(" ");
+    sys_puts(name);
+    sys_puts("\n");
+}
+
+/*
+ * Free-heavy kernel worker for 'workq': every free defers its
+ * coalescing. Kernel-mode, as processes no longer touch the kernel heap.
+ */
+void kproc_churn(void)
+{
+    size_t size = 32 + 16 * (uint32_t)(scheduler_current_pid() % 8);
+    for (int i = 0; i < WORKQ_TEST_FREES; i++)
+    {
+        void *block = heap_alloc(size);
+        if (block)
+            heap_free_deferred(block);
+        if (i % 8 == 7)
+            scheduler_yield();
+    }
+}
+
+/* Periodic control loop for 'edf': a short burst of work per period */
+void test_proc_control(void)
+{
+    int32_t pid = sys_getpid();
+    uint32_t period_us = (pid & 1) ? 20000 : 50000;
+    uint32_t runtime_us = period_us / 10;
+    uint32_t deadline_us = period_us / 2;
+
+    if (sys_edf_set(runtime_us, period_us, deadline_us) != 0)
+    {
+        sys_puts("    [P] EDF admission failed\n");
+        return;
+    }
+
+    uint32_t x = (uint32_t)pid, missed = 0;
+    for (int job = 0; job < EDF_TEST_JOBS; job++)
+    {
+        for (int i = 0; i < EDF_TEST_JOB_WORK; i++)
+            x = x * 1664525u + 1013904223u;
+        missed += (uint32_t)sys_edf_wait();
+    }
+    if (x == 0)
+        sys_puts("    [P] (unlikely)\n"); /* keeps the loop from being optimized out */
+
+    sys_puts("    [P] PID ");
+    sys_put_dec((uint32_t)pid);
+    sys_puts(": period ");
+    sys_put_dec(period_us / 1000);
+    sys_puts(" ms, ");
+    sys_put_dec(EDF_TEST_JOBS);
+    sys_puts(" jobs, ");
+    sys_put_dec(missed);
+    sys_puts(" deadline misses\n");
+}
+
+/* Asks for more bandwidth than is left next to the control loops */
+void test_proc_edf_greedy(void)
+{
+    sys_puts(sys_edf_set(800000, 1000000, 0) != 0 ? "    [P] 80% EDF task rejected by admission control\n"
+                                                  : "    [P] 80% EDF task admitted (unexpected)\n");
+}
+
+/* Sleep a PID-dependent time and report how long it really took */
+void test_proc_sleep(void)
+{
+    int32_t pid = sys_getpid();
+    uint32_t ms = SLEEP_TEST_BASE_MS * (uint32_t)(pid % SLEEP_TEST_PROCS + 1);
+    uint32_t start = sys_uptime();
+    sys_sleep(ms);
+    uint32_t took = sys_uptime() - start;
+
+    sys_puts("    [P] PID ");
+    sys_put_dec((uint32_t)pid);
+    sys_puts(" asked for ");
+    sys_put_dec(ms);
+    sys_puts(" ms, slept ");
+    sys_put_dec(took);
+    sys_puts(" ms\n");
 }
 
 /* ================================================================
@@ -85,11 +537,11 @@ void test_process_complete(void)
     serial_puts("─────────────────────────────────────\n");
 
     serial_puts("1. Creating PID 1... ");
-    int32_t p1 = proc_create(test_proc_hello);
+    int32_t p1 = proc_create(test_proc_hello, 0);
     serial_puts(p1 >= 0 ? "✓\n" : "✗\n");
 
     serial_puts("2. Creating PID 2... ");
-    int32_t p2 = proc_create(test_proc_count);
+    int32_t p2 = proc_create(test_proc_count, 0);
     serial_puts(p2 >= 0 ? "✓\n" : "✗\n");
 
     serial_puts("3. Setting PID 1 to READY... ");
@@ -138,9 +590,9 @@ void test_scheduler_complete(void)
     scheduler_init();
 
     serial_puts("2. Creating test processes...\n");
-    int32_t p1 = proc_create(test_proc_hello);
-    int32_t p2 = proc_create(test_proc_count);
-    int32_t p3 = proc_create(test_proc_mem);
+    int32_t p1 = proc_create(test_proc_hello, 0);
+    int32_t p2 = proc_create(test_proc_count, 0);
+    int32_t p3 = proc_create(test_proc_mem, 0);
 
     serial_puts("   PID 1, 2, 3 created ✓\n");
 
@@ -155,6 +607,198 @@ void test_scheduler_complete(void)
     serial_puts("\n✓ SCHEDULER: OK\n");
 }
 
+/* ================================================================
+ * MEMORY STATUS
+ * ================================================================ */
+void print_meminfo(void)
+{
+    HeapStats st;
+    heap_get_stats(&st);
+
+    serial_puts("Memory Status:\n");
+    serial_puts("  Stack: ");
+    serial_put_dec(st.stack_in_use);
+    serial_puts(" / ");
+    serial_put_dec(STACK_SIZE);
+    serial_puts(" bytes used\n");
+
+    serial_puts("  Heap:  ");
+    serial_put_dec(st.bytes_in_use);
+    serial_puts(" used, ");
+    serial_put_dec(st.bytes_free);
+    serial_puts(" free (");
+    serial_put_dec(st.heap_total);
+    serial_puts(" total)\n");
+
+    serial_puts("  Peak in use: ");
+    serial_put_dec(st.peak_in_use);
+    serial_puts(" bytes\n");
+
+    serial_puts("  Largest free block: ");
+    serial_put_dec(st.largest_free);
+    serial_puts(" bytes\n");
+
+    serial_puts("  Segments: ");
+    serial_put_dec(st.used_segments);
+    serial_puts(" used, ");
+    serial_put_dec(st.free_segments);
+    serial_puts(" free\n");
+
+    serial_puts("  Allocs: ");
+    serial_put_dec(st.alloc_count);
+    serial_puts("  Frees: ");
+    serial_put_dec(st.free_count);
+    serial_puts("  Failed: ");
+    serial_put_dec(st.failed_allocs);
+    serial_puts("\n");
+
+    serial_puts("  Fragmentation: ");
+    serial_put_dec(st.fragmentation / 1000);
+    serial_putc('.');
+    serial_putc('0' + (st.fragmentation / 100) % 10);
+    serial_putc('0' + (st.fragmentation / 10) % 10);
+    serial_putc('0' + st.fragmentation % 10);
+    serial_puts("\n");
+
+    serial_puts("  Size histogram:\n");
+    for (int i = 0; i < HEAP_HIST_BUCKETS; i++)
+    {
+        if (i == HEAP_HIST_BUCKETS - 1)
+        {
+            serial_puts("    >");
+            serial_put_dec(16u << (i - 1));
+        }
+        else
+        {
+            serial_puts("    <=");
+            serial_put_dec(16u << i);
+        }
+        serial_puts(": ");
+        serial_put_dec(st.size_hist[i]);
+        serial_puts("\n");
+    }
+
+    serial_puts("  Reclaim below ");
+    serial_put_dec(HEAP_LOW_WATERMARK);
+    serial_puts(" free bytes, up to ");
+    serial_put_dec(HEAP_HIGH_WATERMARK);
+    serial_puts(":\n");
+    heap_print_shrinkers();
+}
+
+/* ================================================================
+ * TOP: processes sorted by CPU use since the previous frame
+ * ================================================================ */
+static uint64_t top_last_tsc = 0;
+static uint64_t top_last_run[MAX_PROCS];
+static uint64_t top_last_created[MAX_PROCS];
+
+/* part/whole in tenths of a percent, without 64-bit division */
+static uint32_t permille(uint64_t part, uint64_t whole)
+{
+    while (whole >> 22)
+    {
+        whole >>= 1;
+        part >>= 1;
+    }
+    if (whole == 0)
+        return 0;
+    if (part > whole)
+        part = whole;
+    return (uint32_t)part * 1000 / (uint32_t)whole;
+}
+
+static void put_dec_right(uint32_t value, int width)
+{
+    int digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10)
+        digits++;
+    while (width-- > digits)
+        serial_putc(' ');
+    serial_put_dec(value);
+}
+
+void print_top(void)
+{
+    struct
+    {
+        int32_t pid;
+        uint32_t cpu; /* permille */
+        proc_times_t t;
+    } rows[MAX_PROCS];
+    size_t heap_bytes[MAX_PROCS];
+    int count = 0;
+    uint64_t now = rdtsc();
+
+    for (int32_t pid = 0; pid < MAX_PROCS; pid++)
+    {
+        proc_times_t t;
+        if (proc_get_times(pid, &t) != 0)
+            continue;
+
+        /* Same process as last frame: CPU use over the interval; else over its lifetime */
+        uint64_t run = t.run_tsc;
+        uint64_t window = now - t.created_tsc;
+        if (top_last_tsc != 0 && top_last_created[pid] == t.created_tsc)
+        {
+            run -= top_last_run[pid];
+            window = now - top_last_tsc;
+        }
+        top_last_run[pid] = t.run_tsc;
+        top_last_created[pid] = t.created_tsc;
+
+        /* Insertion sort, busiest first */
+        uint32_t cpu = permille(run, window);
+        int at = count++;
+        while (at > 0 && rows[at - 1].cpu < cpu)
+        {
+            rows[at] = rows[at - 1];
+            at--;
+        }
+        rows[at].pid = pid;
+        rows[at].cpu = cpu;
+        rows[at].t = t;
+    }
+    uint32_t interval = top_last_tsc ? timer_tsc_to_ms(now - top_last_tsc) : 0;
+    top_last_tsc = now;
+    heap_bytes_by_owner(heap_bytes, MAX_PROCS);
+
+    serial_puts("\ntop - ");
+    serial_put_dec((uint32_t)count);
+    serial_puts(" processes, ");
+    serial_put_dec((uint32_t)smp_cpu_count());
+    serial_puts(" CPU(s), ");
+    if (interval)
+    {
+        serial_put_dec(interval);
+        serial_puts(" ms since last frame\n");
+    }
+    else
+        serial_puts("since creation\n");
+    serial_puts("PID STATE   %CPU  RUN ms WAIT ms BLKD ms   VCSW  IVCSW   HEAP\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        static const char *const names[] = {"TERM ", "NEW  ", "READY", "RUN  ", "BLOCK", "SLEEP"};
+        int32_t pid = rows[i].pid;
+
+        put_dec_right((uint32_t)pid, 3);
+        serial_puts(" ");
+        serial_puts(names[proc_get_state(pid)]);
+        put_dec_right(rows[i].cpu / 10, 5);
+        serial_putc('.');
+        serial_putc('0' + rows[i].cpu % 10);
+        put_dec_right(timer_tsc_to_ms(rows[i].t.run_tsc), 8);
+        put_dec_right(timer_tsc_to_ms(rows[i].t.ready_tsc), 8);
+        put_dec_right(timer_tsc_to_ms(rows[i].t.blocked_tsc), 8);
+        put_dec_right(rows[i].t.switches_voluntary, 7);
+        put_dec_right(rows[i].t.switches_involuntary, 7);
+        /* Kernel-heap blocks tagged to it plus its own heap */
+        put_dec_right((uint32_t)heap_bytes[pid] + proc_heap_bytes(pid), 7);
+        serial_puts("\n");
+    }
+}
+
 /* ================================================================
  * COMPLETE SYSTEM TEST
  * ================================================================ */
@@ -179,23 +823,62 @@ void run_full_test(void)
 /* ================================================================
  * MAIN KERNEL
  * ================================================================ */
-void kmain(void)
+void kmain(uint32_t magic, const multiboot_info_t *mbi)
 {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC)
+        mbi = NULL;
+    boottime_init(mbi);
+
     serial_init();
+    boot_phase("serial_init");
+    gdt_init();
+    idt_init();
+    boot_phase("gdt/idt");
+    fpu_init();
+    boot_phase("fpu_init");
+    paging_init();
+    boot_phase("paging_init");
+    /* Reserves the module frames, so it must come before the first frame_alloc() */
+    ramfs_init(mbi);
+    boot_phase("ramfs_init");
+    syscall_init();
     memory_init();
+    boot_phase("memory_init");
     proc_init();
+    boot_phase("proc_init");
+    scheduler_init();
+    boot_phase("scheduler_init");
+    timer_init();
+    boot_phase("timer_init");
+    smp_init();
+    boot_phase("smp_init");
+    workq_init();
+    cpu_irq_enable();
+    boot_phase("workq_init");
 
-    serial_puts("\n════════════════════════════════════\n");
-    serial_puts("   kacchiOS v0.1.0\n");
-    serial_puts("   Baremetal OS with Memory, Process,\n");
-    serial_puts("   and Scheduler Support\n");
-    serial_puts("════════════════════════════════════\n");
+    /* 'quiet' drops the banners and the self-tests, 'noselftest' just the tests */
+    int quiet = boot_option("quiet");
+    if (!quiet)
+    {
+        serial_puts("\n════════════════════════════════════\n");
+        serial_puts("   kacchiOS v0.1.0\n");
+        serial_puts("   Baremetal OS with Memory, Process,\n");
+        serial_puts("   and Scheduler Support\n");
+        serial_puts("════════════════════════════════════\n");
+    }
 
-    serial_puts("\n[INFO] Running startup tests...\n");
-    stress_test_memory();
+    if (!quiet && !boot_option("noselftest"))
+    {
+        serial_puts("\n[INFO] Running startup tests...\n");
+        stress_test_memory();
+    }
+    boot_phase("self-tests");
 
-    serial_puts("\n[READY] Type 'test' for full verification\n");
-    serial_puts("Type 'help' for commands\n\n");
+    if (!quiet)
+    {
+        serial_puts("\n[READY] Type 'test' for full verification\n");
+        serial_puts("Type 'help' for commands\n\n");
+    }
 
     char input[MAX_INPUT];
     int pos = 0;
@@ -239,20 +922,45 @@ void kmain(void)
                 serial_puts("  alloc <size> - Allocate memory (e.g., alloc 512)\n");
                 serial_puts("  free         - Free last allocated block\n");
                 serial_puts("  meminfo      - Show memory status\n");
+                serial_puts("  meminfo -b   - Stream binary heap snapshot\n");
+                serial_puts("  leaks        - Outstanding heap blocks by owner\n");
+                serial_puts("  tlb          - Measure TLB flush / refill cost\n");
+                serial_puts("  schedbench   - Process table scan and run-queue cost by size\n");
+                serial_puts("  sysbench     - Null syscall latency, SYSENTER vs int 0x80\n");
+                serial_puts("  smpbench [n] - Run n CPU-bound workers on all CPUs\n");
+                serial_puts("  fpu          - Lazy FPU switching between processes\n");
+                serial_puts("  sleep        - Timed sleeps on the tickless clock\n");
+                serial_puts("  uptime       - Monotonic clock and per-CPU idle time\n");
+                serial_puts("  mutex        - Contended futex mutex between processes\n");
+                serial_puts("  select       - One server waiting on channels, mailbox and timer\n");
+                serial_puts("  tasks        - Stackless tasks on one process: timers and a channel\n");
+                serial_puts("  workq        - Deferred heap coalescing on the kernel worker\n");
+                serial_puts("  edf          - EDF control loops next to bulk work\n");
+                serial_puts("  prof start|stop|dump - Sample EIP/PID on a periodic timer\n");
+                serial_puts("  trace [clear] - Dump (or reset) the scheduler event trace\n");
                 serial_puts("\n=== PROCESS OPERATIONS ===\n");
                 serial_puts("  ps           - List all processes\n");
                 serial_puts("  ps -a        - Show process details with aging\n");
-                serial_puts("  create       - Create a new process\n");
+                serial_puts("  create [stack] - Create a new process (stack bytes)\n");
+                serial_puts("  fork         - Queue a copy-on-write fork demo\n");
                 serial_puts("  kill <pid>   - Terminate process (e.g., kill 1)\n");
                 serial_puts("  getinfo <pid> - Get detailed process info\n");
+                serial_puts("  top          - Processes by CPU use since the last frame\n");
+                serial_puts("  top on|off   - Refresh top every second while processes run\n");
                 serial_puts("  run          - Execute scheduler\n");
                 serial_puts("\n=== IPC COMMUNICATION ===\n");
                 serial_puts("  send <pid> <msg> - Send message to process\n");
                 serial_puts("  recv <pid>       - Receive message from process\n");
+                serial_puts("\n=== FILES ===\n");
+                serial_puts("  ls           - List the boot-module files\n");
+                serial_puts("  cat <name>   - Print a file\n");
+                serial_puts("  wc <name>    - Count lines, words, bytes from a process mapping\n");
+                serial_puts("  exec <name> [n] - Run n instances of an ELF program, with launch cost\n");
                 serial_puts("\n=== SCHEDULER INFO ===\n");
                 serial_puts("  info        - Show scheduler and context info\n");
                 serial_puts("\n=== UTILITIES ===\n");
                 serial_puts("  version      - Show OS version\n");
+                serial_puts("  boottime     - Time spent in each boot phase\n");
                 serial_puts("  clear        - Clear screen\n");
                 serial_puts("  help         - Show this help\n");
             }
@@ -293,29 +1001,277 @@ void kmain(void)
                     if (parsed > 0)
                         size = parsed;
                 }
-                void *ptr = heap_alloc(size);
-                if (ptr)
-                    serial_puts("✓ Allocated memory\n");
+                if (shell_alloc_count == SHELL_MAX_ALLOCS)
+                {
+                    serial_puts("✗ Too many outstanding blocks, use 'free' first\n");
+                }
                 else
-                    serial_puts("✗ Allocation failed\n");
+                {
+                    void *ptr = heap_alloc(size);
+                    if (ptr)
+                    {
+                        shell_allocs[shell_alloc_count++] = ptr;
+                        serial_puts("✓ Allocated memory\n");
+                    }
+                    else
+                        serial_puts("✗ Allocation failed\n");
+                }
             }
             else if (string_equal(input, "free"))
             {
-                heap_free(512);
-                serial_puts("✓ Memory freed\n");
+                if (shell_alloc_count > 0)
+                {
+                    heap_free(shell_allocs[--shell_alloc_count]);
+                    serial_puts("✓ Memory freed\n");
+                }
+                else
+                    serial_puts("✗ Nothing allocated from the shell\n");
+            }
+            else if (string_equal(input, "leaks"))
+            {
+                heap_report_leaks();
             }
             else if (string_equal(input, "meminfo"))
             {
-                serial_puts("Memory Status:\n");
-                serial_puts("  Stack: 4KB\n");
-                serial_puts("  Heap: 8KB\n");
-                serial_puts("  Available: Check with 'test'\n");
+                print_meminfo();
+            }
+            else if (string_equal(input, "sysbench"))
+            {
+                int32_t pid = proc_create(test_proc_syscall_bench, 0);
+                if (pid >= 0)
+                {
+                    proc_set_state(pid, PR_READY);
+                    scheduler_run();
+                }
+                else
+                    serial_puts("✗ Process creation failed\n");
+            }
+            else if (string_starts_with(input, "smpbench"))
+            {
+                int workers = SMP_BENCH_WORKERS;
+                if (pos > 9)
+                {
+                    int parsed = 0;
+                    for (int i = 9; i < pos && input[i] >= '0' && input[i] <= '9'; i++)
+                        parsed = parsed * 10 + (input[i] - '0');
+                    if (parsed > 0)
+                        workers = parsed;
+                }
+
+                int created = 0;
+                for (int i = 0; i < workers; i++)
+                {
+                    int32_t pid = proc_create(test_proc_spin, 0);
+                    if (pid < 0)
+                        break;
+                    proc_set_state(pid, PR_READY);
+                    created++;
+                }
+
+                uint64_t t0 = rdtsc();
+                scheduler_run();
+                uint64_t elapsed = rdtsc() - t0;
+
+                serial_puts("\n");
+                serial_put_dec((uint32_t)created);
+                serial_puts(" workers on ");
+                serial_put_dec((uint32_t)smp_cpu_count());
+                serial_puts(" CPU(s): ");
+                serial_put_dec((uint32_t)(elapsed >> 20));
+                serial_puts(" Mcycles\n");
+                scheduler_print_cpu_stats();
+            }
+            else if (string_equal(input, "fpu"))
+            {
+                uint32_t before = fpu_area_count();
+                int32_t pids[4] = {proc_create(test_proc_fpu, 0), proc_create(test_proc_fpu, 0),
+                                   proc_create(test_proc_fpu, 0), proc_create(test_proc_hello, 0)};
+                for (int i = 0; i < 4; i++)
+                {
+                    if (pids[i] >= 0)
+                        proc_set_state(pids[i], PR_READY);
+                }
+                scheduler_run();
+
+                /* The hello process never touches the FPU and gets no area */
+                serial_puts("FPU save areas allocated: ");
+                serial_put_dec(fpu_area_count() - before);
+                serial_puts(" (expected 3)\n");
+            }
+            else if (string_equal(input, "sleep"))
+            {
+                uint32_t before = timer_interrupts();
+                for (int i = 0; i < SLEEP_TEST_PROCS; i++)
+                {
+                    int32_t pid = proc_create(test_proc_sleep, 0);
+                    if (pid >= 0)
+                        proc_set_state(pid, PR_READY);
+                }
+                scheduler_run();
+
+                /* Only the deadlines themselves should have fired here */
+                serial_puts("Timer interrupts on this CPU: ");
+                serial_put_dec(timer_interrupts() - before);
+                serial_puts("\n");
+            }
+            else if (string_equal(input, "mutex"))
+            {
+                mutex_test.lock = 0;
+                mutex_test.counter = 0;
+                uint32_t sleeps = futex_sleeps();
+                int created = 0;
+                for (int i = 0; i < MUTEX_TEST_PROCS; i++)
+                {
+                    int32_t pid = proc_create(test_proc_mutex, 0);
+                    if (pid < 0)
+                        break;
+                    proc_set_state(pid, PR_READY);
+                    created++;
+                }
+                scheduler_run();
+
+                uint32_t expected = (uint32_t)created * MUTEX_TEST_ROUNDS;
+                serial_puts(mutex_test.counter == expected ? "✓" : "✗");
+                serial_puts(" Counter ");
+                serial_put_dec(mutex_test.counter);
+                serial_puts(" (expected ");
+                serial_put_dec(expected);
+                serial_puts("), ");
+                serial_put_dec(futex_sleeps() - sleeps);
+                serial_puts(" futex sleeps\n");
+            }
+            else if (string_equal(input, "select"))
+            {
+                int32_t pid = proc_create(test_proc_select, 0);
+                if (pid >= 0)
+                {
+                    proc_set_state(pid, PR_READY);
+                    scheduler_run();
+                }
+                else
+                    serial_puts("✗ Process creation failed\n");
+            }
+            else if (string_equal(input, "tasks"))
+            {
+                int32_t pid = proc_create(test_proc_tasks, TASKS_TEST_STACK);
+                if (pid >= 0)
+                {
+                    proc_set_state(pid, PR_READY);
+                    scheduler_run();
+                }
+                else
+                    serial_puts("✗ Process creation failed\n");
+            }
+            else if (string_equal(input, "workq"))
+            {
+                for (int i = 0; i < WORKQ_TEST_PROCS; i++)
+                {
+                    int32_t pid = proc_create_kernel(kproc_churn);
+                    if (pid >= 0)
+                        proc_set_state(pid, PR_READY);
+                }
+                scheduler_run();
+                workq_print_stats();
+            }
+            else if (string_equal(input, "edf"))
+            {
+                /* Control loops first so they are admitted before the greedy task asks */
+                void (*entries[])(void) = {test_proc_control, test_proc_control, test_proc_edf_greedy};
+                for (int i = 0; i < 3 + EDF_TEST_BULK; i++)
+                {
+                    int32_t pid = proc_create(i < 3 ? entries[i] : test_proc_spin, 0);
+                    if (pid >= 0)
+                        proc_set_state(pid, PR_READY);
+                }
+                scheduler_run();
+
+                serial_puts("EDF load after exit: ");
+                serial_put_dec(scheduler_edf_load());
+                serial_puts(" ppm (expected 0)\n");
+            }
+            else if (string_equal(input, "boottime"))
+            {
+                boot_print_times();
+            }
+            else if (string_equal(input, "uptime"))
+            {
+                uint32_t ms = timer_ns_to_ms(clock_ns());
+                serial_puts("Up ");
+                serial_put_dec(ms / 1000);
+                serial_puts(ms % 1000 < 100 ? (ms % 1000 < 10 ? ".00" : ".0") : ".");
+                serial_put_dec(ms % 1000);
+                serial_puts(" s\n");
+                for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+                {
+                    if (!smp_cpu_online(cpu))
+                        continue;
+                    serial_puts("  CPU ");
+                    serial_put_dec((uint32_t)cpu);
+                    serial_puts(": idle ");
+                    serial_put_dec(permille(timer_idle_ns(cpu), clock_ns()) / 10);
+                    serial_puts("%\n");
+                }
+            }
+            else if (string_equal(input, "prof start"))
+            {
+                if (!timer_available())
+                    serial_puts("✗ No timer interrupt to sample from\n");
+                else
+                {
+                    prof_start();
+                    serial_puts("✓ Profiling on a one-shot timer (");
+                    serial_put_dec(PROF_HZ);
+                    serial_puts(" Hz per CPU)\n");
+                }
+            }
+            else if (string_equal(input, "prof stop"))
+            {
+                prof_stop();
+                serial_put_dec(prof_sample_count());
+                serial_puts(" samples, ");
+                serial_put_dec(prof_dropped());
+                serial_puts(" dropped\n");
+            }
+            else if (string_equal(input, "prof dump"))
+            {
+                /* Framed raw dump for tools/profsym.py */
+                prof_stop();
+                serial_puts("--- PROF BEGIN ---\n");
+                prof_write_samples();
+                serial_puts("\n--- PROF END ---\n");
+            }
+            else if (string_equal(input, "trace"))
+            {
+                /* Framed raw dump for tools/trace2json.py */
+                serial_puts("--- TRACE BEGIN ---\n");
+                trace_write();
+                serial_puts("\n--- TRACE END ---\n");
+            }
+            else if (string_equal(input, "trace clear"))
+            {
+                trace_clear();
+                serial_puts("✓ Trace buffers cleared\n");
+            }
+            else if (string_equal(input, "schedbench"))
+            {
+                scheduler_measure();
+            }
+            else if (string_equal(input, "tlb"))
+            {
+                paging_measure_tlb();
+            }
+            else if (string_equal(input, "meminfo -b"))
+            {
+                /* Framed raw dump for tools/heapsnap.py */
+                serial_puts("--- HEAPSNAP BEGIN ---\n");
+                heap_write_snapshot();
+                serial_puts("\n--- HEAPSNAP END ---\n");
             }
             else if (string_equal(input, "ps"))
             {
                 int count = 0;
                 serial_puts("Process List:\n");
-                for (int i = 0; i < 16; i++)
+                for (int i = 0; i < MAX_PROCS; i++)
                 {
                     if (proc_is_alive(i))
                     {
@@ -341,16 +1297,19 @@ void kmain(void)
                     }
                 }
                 serial_puts("Total: ");
-                char countbuf[8];
-                countbuf[0] = '0' + (count / 10);
-                countbuf[1] = '0' + (count % 10);
-                countbuf[2] = '\0';
-                serial_puts(countbuf);
-                serial_puts("/16 processes\n");
+                serial_put_dec(count);
+                serial_puts("/");
+                serial_put_dec(MAX_PROCS);
+                serial_puts(" processes\n");
             }
-            else if (string_equal(input, "create"))
+            else if (string_starts_with(input, "create"))
             {
-                int32_t pid = proc_create(test_proc_hello);
+                /* Optional stack size: create <bytes> */
+                uint32_t stack_size = 0;
+                for (int i = 7; i < pos && input[i] >= '0' && input[i] <= '9'; i++)
+                    stack_size = stack_size * 10 + (input[i] - '0');
+
+                int32_t pid = proc_create(test_proc_hello, stack_size);
                 if (pid >= 0)
                 {
                     serial_puts("✓ Process created: PID ");
@@ -365,11 +1324,24 @@ void kmain(void)
                 else
                 {
                     serial_puts("✗ Process creation failed\n");
-                    serial_puts("  Reason: Process table full or max (16) reached\n");
+                    serial_puts("  Reason: Process table full or out of memory\n");
                     serial_puts("  Use 'ps' to see active processes\n");
                     serial_puts("  Use 'kill <pid>' to terminate a process\n");
                 }
             }
+            else if (string_equal(input, "fork"))
+            {
+                int32_t pid = proc_create(test_proc_fork, 0);
+                if (pid >= 0)
+                {
+                    proc_set_state(pid, PR_READY);
+                    serial_puts("✓ Fork demo queued as PID ");
+                    serial_put_dec(pid);
+                    serial_puts(", use 'run'\n");
+                }
+                else
+                    serial_puts("✗ Process creation failed\n");
+            }
             else if (string_starts_with(input, "kill"))
             {
                 int pid = 0;
@@ -381,8 +1353,10 @@ void kmain(void)
                     if (parsed >= 0)
                         pid = parsed;
                 }
-                proc_terminate(pid);
-                serial_puts("✓ Process terminated\n");
+                if (proc_terminate(pid) == 0)
+                    serial_puts("✓ Process terminated\n");
+                else
+                    serial_puts("✗ Cannot terminate that process\n");
             }
             else if (string_equal(input, "run"))
             {
@@ -390,6 +1364,115 @@ void kmain(void)
                 scheduler_run();
                 serial_puts("✓ Scheduler completed\n");
             }
+            else if (string_equal(input, "ls"))
+            {
+                if (ramfs_count() == 0)
+                    serial_puts("No files (pass boot modules to load some)\n");
+                for (int fd = 0; fd < ramfs_count(); fd++)
+                {
+                    serial_puts("  ");
+                    serial_puts(ramfs_name(fd));
+                    serial_puts("  ");
+                    serial_put_dec(ramfs_size(fd));
+                    serial_puts(" bytes\n");
+                }
+            }
+            else if (string_starts_with(input, "cat"))
+            {
+                int fd = pos > 4 ? ramfs_open(input + 4) : -1;
+                if (fd < 0)
+                    serial_puts("Usage: cat <name> (see ls)\n");
+                else
+                {
+                    const void *chunk;
+                    uint32_t offset = 0;
+                    uint32_t len;
+                    char last = '\n';
+                    while ((len = ramfs_read(fd, offset, 256, &chunk)) > 0)
+                    {
+                        const char *p = chunk;
+                        for (uint32_t i = 0; i < len; i++)
+                        {
+                            last = p[i];
+                            serial_putc((last >= 32 && last < 127) || last == '\n' || last == '\t' ? last : '.');
+                        }
+                        offset += len;
+                    }
+                    if (last != '\n')
+                        serial_puts("\n");
+                }
+            }
+            else if (string_starts_with(input, "wc"))
+            {
+                if (pos <= 3 || ramfs_open(input + 3) < 0)
+                    serial_puts("Usage: wc <name> (see ls)\n");
+                else
+                {
+                    int32_t pid = proc_create(test_proc_wc, 0);
+                    if (pid >= 0 && proc_send(pid, input + 3) == 0)
+                    {
+                        proc_set_state(pid, PR_READY);
+                        scheduler_run();
+                    }
+                    else
+                        serial_puts("✗ Process creation failed\n");
+                }
+            }
+            else if (string_starts_with(input, "exec"))
+            {
+                /* Parse: exec <name> [n] */
+                char name[RAMFS_NAME_MAX];
+                int i = 5; /* skip "exec " */
+                int len = 0;
+                while (i < pos && input[i] != ' ' && len < RAMFS_NAME_MAX - 1)
+                    name[len++] = input[i++];
+                name[len] = '\0';
+
+                int count = 0;
+                while (i < pos && input[i] == ' ')
+                    i++;
+                while (i < pos && input[i] >= '0' && input[i] <= '9')
+                    count = count * 10 + (input[i++] - '0');
+                if (count <= 0)
+                    count = 1;
+
+                if (len == 0 || ramfs_open(name) < 0)
+                    serial_puts("Usage: exec <name> [n] (see ls)\n");
+                else
+                {
+                    /* Per-instance cost: it should not grow with the instance count */
+                    uint32_t frames_before = frame_free_count();
+                    uint32_t cycles = 0;
+                    int started = 0;
+                    for (; started < count; started++)
+                    {
+                        uint64_t t0 = rdtsc();
+                        int32_t pid = proc_exec(name, 0);
+                        if (pid < 0)
+                            break;
+                        cycles += (uint32_t)(rdtsc() - t0);
+                        proc_set_state(pid, PR_READY);
+                    }
+
+                    if (started == 0)
+                        serial_puts("✗ Not a loadable ELF32 executable\n");
+                    else
+                    {
+                        uint32_t frames = frames_before - frame_free_count();
+                        serial_put_dec((uint32_t)started);
+                        serial_puts(" instance(s) of ");
+                        serial_puts(name);
+                        serial_puts(": ");
+                        serial_put_dec(cycles / (uint32_t)started);
+                        serial_puts(" cycles and ");
+                        serial_put_dec(frames / (uint32_t)started);
+                        serial_puts(" frames (");
+                        serial_put_dec(frames * (PAGE_SIZE / 1024) / (uint32_t)started);
+                        serial_puts(" KB) per launch\n");
+                        scheduler_run();
+                    }
+                }
+            }
             else if (string_starts_with(input, "send"))
             {
                 int pid = -1;
@@ -469,9 +1552,9 @@ void kmain(void)
             {
                 int count = 0;
                 serial_puts("Process Details (with Aging):\n");
-                serial_puts("PID | State    | Age\n");
-                serial_puts("----+----------+-----\n");
-                for (int i = 0; i < 16; i++)
+                serial_puts("PID | State    | Age | Stack used/limit\n");
+                serial_puts("----+----------+-----+----------------\n");
+                for (int i = 0; i < MAX_PROCS; i++)
                 {
                     if (proc_is_alive(i))
                     {
@@ -497,14 +1580,33 @@ void kmain(void)
                             serial_puts(" | ");
                             serial_putc('0' + (pcb->age / 10));
                             serial_putc('0' + (pcb->age % 10));
+                            serial_puts("  | ");
+                            serial_put_dec(proc_stack_high_water(i));
+                            serial_puts("/");
+                            serial_put_dec(pcb->stack_size);
                             serial_puts("\n");
                         }
                     }
                 }
                 serial_puts("Total: ");
-                serial_putc('0' + (count / 10));
-                serial_putc('0' + (count % 10));
-                serial_puts("/16 processes\n");
+                serial_put_dec(count);
+                serial_puts("/");
+                serial_put_dec(MAX_PROCS);
+                serial_puts(" processes\n");
+            }
+            else if (string_equal(input, "top"))
+            {
+                print_top();
+            }
+            else if (string_equal(input, "top on"))
+            {
+                scheduler_set_monitor(print_top);
+                serial_puts("✓ top refreshes every second during 'run'\n");
+            }
+            else if (string_equal(input, "top off"))
+            {
+                scheduler_set_monitor(NULL);
+                serial_puts("✓ top refresh off\n");
             }
             else if (string_starts_with(input, "getinfo"))
             {
@@ -541,10 +1643,48 @@ void kmain(void)
                     serial_putc('0' + (pcb->age / 10));
                     serial_putc('0' + (pcb->age % 10));
                     serial_puts(" ticks\n");
-                    serial_puts("  Stack Size: ");
-                    serial_puts(pcb->stack_size == 512 ? "512B\n" : "?KB\n");
+                    serial_puts("  Stack Limit: ");
+                    serial_put_dec(pcb->stack_size);
+                    serial_puts("B\n");
+                    serial_puts("  Stack Committed: ");
+                    serial_put_dec(proc_stack_committed(pid));
+                    serial_puts("B\n");
+                    serial_puts("  Stack High-Water: ");
+                    serial_put_dec(proc_stack_high_water(pid));
+                    serial_puts("B\n");
                     serial_puts("  Has Message: ");
                     serial_puts(pcb->has_msg ? "Yes\n" : "No\n");
+
+                    proc_times_t t;
+                    if (proc_get_times(pid, &t) == 0)
+                    {
+                        serial_puts("  CPU Time: ");
+                        serial_put_dec(timer_tsc_to_ms(t.run_tsc));
+                        serial_puts(" ms running, ");
+                        serial_put_dec(timer_tsc_to_ms(t.ready_tsc));
+                        serial_puts(" ms ready, ");
+                        serial_put_dec(timer_tsc_to_ms(t.blocked_tsc));
+                        serial_puts(" ms blocked\n");
+                        serial_puts("  Context Switches: ");
+                        serial_put_dec(t.switches_voluntary);
+                        serial_puts(" voluntary, ");
+                        serial_put_dec(t.switches_involuntary);
+                        serial_puts(" involuntary\n");
+                    }
+                    if (pcb->rt_period_us)
+                    {
+                        serial_puts("  EDF: ");
+                        serial_put_dec(pcb->rt_runtime_us);
+                        serial_puts("/");
+                        serial_put_dec(pcb->rt_period_us);
+                        serial_puts("/");
+                        serial_put_dec(pcb->rt_deadline_us);
+                        serial_puts(" us runtime/period/deadline, ");
+                        serial_put_dec(pcb->rt_misses);
+                        serial_puts(" missed, ");
+                        serial_put_dec(pcb->rt_overruns);
+                        serial_puts(" overran\n");
+                    }
                 }
                 else
                     serial_puts("✗ Invalid PID or process terminated\n");
@@ -552,9 +1692,18 @@ void kmain(void)
             else if (string_equal(input, "info"))
             {
                 serial_puts("Scheduler Information:\n");
-                serial_puts("  Type: Round-Robin (Cooperative)\n");
+                serial_puts("  Type: Round-Robin (Cooperative), EDF class above it\n");
                 serial_puts("  Policy: Non-preemptive context switching\n");
-                serial_puts("  Max Processes: 16\n");
+                serial_puts("  Max Processes: ");
+                serial_put_dec(MAX_PROCS);
+                serial_puts("\n");
+                serial_puts("  CPUs Online: ");
+                serial_put_dec((uint32_t)smp_cpu_count());
+                serial_puts(" (per-CPU run queues, work stealing)\n");
+                serial_puts("  EDF Load: ");
+                serial_put_dec(scheduler_edf_load() / 1000);
+                serial_puts("‰ of one CPU admitted\n");
+                scheduler_print_cpu_stats();
                 serial_puts("  Context Switch: Cooperative (explicit yield)\n");
                 serial_puts("  Bonus Features:\n");
                 serial_puts("    - Process Aging support\n");
@@ -0,0 +1,70 @@
+/* lapic.c - Local APIC registers, EOI and inter-processor interrupts */
+#include "lapic.h"
+#include "cpu.h"
+#include "paging.h"
+#include "spinlock.h"
+
+#define ICR_PENDING 0x00001000
+
+static volatile uint32_t *lapic = NULL;
+
+int lapic_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    if (!(d & CPUID_EDX_APIC))
+    {
+        return -1;
+    }
+
+    /* Every CPU sees its own APIC at the same physical address */
+    uint32_t base = (uint32_t)rdmsr(MSR_APIC_BASE) & 0xFFFFF000u;
+    if (paging_map_identity(base, PAGE_SIZE, PTE_WRITE | PTE_PCD | PTE_PWT) != 0)
+    {
+        return -1;
+    }
+
+    lapic = (volatile uint32_t *)base;
+    lapic_enable();
+    return 0;
+}
+
+int lapic_present(void)
+{
+    return lapic != NULL;
+}
+
+uint32_t lapic_read(uint32_t reg)
+{
+    return lapic[reg / 4];
+}
+
+void lapic_write(uint32_t reg, uint32_t val)
+{
+    lapic[reg / 4] = val;
+}
+
+void lapic_enable(void)
+{
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
+
+uint32_t lapic_id(void)
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint32_t command)
+{
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING)
+    {
+        cpu_relax();
+    }
+}
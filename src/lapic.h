@@ -0,0 +1,53 @@
+/* lapic.h - Local APIC registers, EOI and inter-processor interrupts */
+#ifndef KACCHI_LAPIC_H
+#define KACCHI_LAPIC_H
+
+#include "types.h"
+
+/* Register byte offsets */
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED (1u << 16)
+#define LAPIC_TIMER_PERIODIC (1u << 17)
+#define LAPIC_TIMER_TSC_DEADLINE (2u << 17)
+#define LAPIC_DIVIDE_16 0x3
+
+/* Interrupt vectors owned by the local APIC */
+#define LAPIC_TIMER_VECTOR 0x40
+#define LAPIC_KICK_VECTOR 0x41 /* wake-up IPI for a halted CPU */
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+/*
+ * Map the boot CPU's local APIC (base from IA32_APIC_BASE) and enable
+ * it. -1 if the CPU has none; every other call is then invalid.
+ */
+int lapic_init(void);
+
+/* lapic_init() succeeded */
+int lapic_present(void);
+
+/* Software-enable the calling CPU's APIC (APs; the BSP's is done by lapic_init) */
+void lapic_enable(void);
+
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t val);
+
+/* APIC ID of the calling CPU */
+uint32_t lapic_id(void);
+
+/* Acknowledge the interrupt being serviced */
+void lapic_eoi(void);
+
+/* Send an ICR command to 'apic_id' and wait until it is delivered */
+void lapic_send_ipi(uint32_t apic_id, uint32_t command);
+
+#endif /* KACCHI_LAPIC_H */
@@ -1,12 +1,17 @@
 #include "memory.h"
+#include "scheduler.h"
 #include "serial.h"
+#include "spinlock.h"
+#include "string.h"
+#include "trace.h"
+#include "workq.h"
 
 /*
  * Backing arrays for stack and heap.
  * Exposed as 'stack' / 'heap' via macros in memory.h.
  */
 uint8_t g_stack_store[STACK_SIZE];
-uint8_t g_heap_store[HEAP_SIZE];
+uint8_t g_heap_store[HEAP_SIZE] __attribute__((aligned(16)));
 
 /* Current top of the stack region (offset into g_stack_store) */
 static size_t stack_marker = 0;
@@ -14,6 +19,58 @@ static size_t stack_marker = 0;
 /* Head of the heap segment linked list */
 static HeapSegment *heap_head_node = NULL;
 
+/* Running allocator counters (segment-shape fields filled on demand) */
+static HeapStats heap_counters;
+
+/* Taken by every public heap entry point; static helpers assume it is held */
+static spinlock_t heap_lock = SPINLOCK_INIT;
+
+/* heap_release() left free neighbours unmerged */
+static int heap_unmerged = 0;
+
+/* Deferred frees share one item, so any number of them costs one coalescing pass */
+static void coalesce_work_fn(work_t *work);
+static work_t coalesce_work = WORK_INIT(coalesce_work_fn);
+
+typedef struct
+{
+    const char *name;
+    int priority;
+    heap_shrink_fn fn;
+    uint32_t calls;
+    size_t reclaimed;
+} Shrinker;
+
+/* Sorted by priority; reclaim runs hold shrink_lock, which nests outside heap_lock */
+static Shrinker shrinkers[HEAP_MAX_SHRINKERS];
+static int shrinker_count = 0;
+static spinlock_t shrink_lock = SPINLOCK_INIT;
+
+/* Watermark reclaim, queued by allocations that leave the heap low */
+static void reclaim_work_fn(work_t *work);
+static work_t reclaim_work = WORK_INIT(reclaim_work_fn);
+
+#ifdef KACCHI_HEAP_DEBUG
+/*
+ * Callsite side table: one compact record per live block, looked up by
+ * the block's header offset. Slots with offset HEAP_DEBUG_EMPTY are free.
+ */
+#define HEAP_DEBUG_EMPTY 0xFFFFu
+
+typedef struct
+{
+    uint32_t callsite; /* return address of the heap_alloc caller */
+    uint16_t offset;   /* header offset inside g_heap_store */
+    int16_t pid;       /* owner at allocation time */
+} HeapTag;
+
+static HeapTag heap_tags[HEAP_DEBUG_SLOTS];
+static uint32_t heap_untagged; /* allocations that found the table full */
+#endif
+
+/* Snapshot records pack offsets/lengths into 15 bits */
+typedef char heap_snapshot_fits[(HEAP_SIZE <= 0x8000) ? 1 : -1];
+
 /* --------------------------------------------------------------------------
  * Internal helpers
  * -------------------------------------------------------------------------- */
@@ -25,6 +82,64 @@ static size_t align_to_4(size_t value)
     return (value + mask) & ~mask;
 }
 
+/* Histogram bucket for a request of 'size' bytes */
+static uint32_t size_bucket(size_t size)
+{
+    uint32_t bucket = 0;
+    size_t limit = 16;
+
+    while (bucket < HEAP_HIST_BUCKETS - 1 && size > limit)
+    {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+#ifdef KACCHI_HEAP_DEBUG
+static void tag_insert(HeapSegment *seg, void *callsite)
+{
+    for (int i = 0; i < HEAP_DEBUG_SLOTS; i++)
+    {
+        if (heap_tags[i].offset == HEAP_DEBUG_EMPTY)
+        {
+            heap_tags[i].callsite = (uint32_t)(uintptr_t)callsite;
+            heap_tags[i].offset = (uint16_t)((uint8_t *)seg - g_heap_store);
+            heap_tags[i].pid = seg->owner;
+            return;
+        }
+    }
+    heap_untagged++;
+}
+
+static void tag_remove(HeapSegment *seg)
+{
+    uint16_t offset = (uint16_t)((uint8_t *)seg - g_heap_store);
+    for (int i = 0; i < HEAP_DEBUG_SLOTS; i++)
+    {
+        if (heap_tags[i].offset == offset)
+        {
+            heap_tags[i].offset = HEAP_DEBUG_EMPTY;
+            return;
+        }
+    }
+}
+#endif
+
+/* Mark a live segment free and update counters; no coalescing */
+static void release_segment(HeapSegment *seg)
+{
+    seg->is_free = 1;
+    seg->owner = HEAP_OWNER_KERNEL;
+
+    heap_counters.free_count++;
+    heap_counters.bytes_in_use -= seg->length;
+
+#ifdef KACCHI_HEAP_DEBUG
+    tag_remove(seg);
+#endif
+}
+
 /* Merge consecutive free segments in the heap list */
 static void merge_adjacent_free_segments(void)
 {
@@ -46,6 +161,7 @@ static void merge_adjacent_free_segments(void)
             node = next;
         }
     }
+    heap_unmerged = 0;
 }
 
 /* --------------------------------------------------------------------------
@@ -60,8 +176,20 @@ void memory_init(void)
     heap_head_node = (HeapSegment *)g_heap_store;
     heap_head_node->length = HEAP_SIZE - sizeof(HeapSegment);
     heap_head_node->is_free = 1;
+    heap_head_node->owner = HEAP_OWNER_KERNEL;
     heap_head_node->link = NULL;
 
+    heap_counters = (HeapStats){0};
+    heap_counters.heap_total = HEAP_SIZE;
+
+#ifdef KACCHI_HEAP_DEBUG
+    for (int i = 0; i < HEAP_DEBUG_SLOTS; i++)
+    {
+        heap_tags[i].offset = HEAP_DEBUG_EMPTY;
+    }
+    heap_untagged = 0;
+#endif
+
     /*
      * Reset stack "top" offset.
      */
@@ -106,73 +234,249 @@ void stack_free(size_t size)
 
 /* ---------------- Heap allocator (best-fit + coalescing) --------------- */
 
-void *heap_alloc(size_t size)
+/* Split off the tail of 'seg' as a free segment if it can hold one */
+static void split_tail(HeapSegment *seg, size_t size)
 {
-    if (size == 0)
+    /*
+     * Only split when leftover is large enough for a header + some payload.
+     */
+    const size_t min_payload = 4;
+    const size_t min_remainder = sizeof(HeapSegment) + min_payload;
+
+    if (seg->length >= size + min_remainder)
     {
-        return NULL;
+        uint8_t *base = (uint8_t *)seg;
+        uint8_t *new_seg_addr = base + sizeof(HeapSegment) + size;
+
+        HeapSegment *split = (HeapSegment *)new_seg_addr;
+        split->length = seg->length - size - sizeof(HeapSegment);
+        split->is_free = 1;
+        split->owner = HEAP_OWNER_KERNEL;
+        split->link = seg->link;
+
+        seg->length = size;
+        seg->link = split;
     }
+}
 
-    /* 1. Align requested size to 4 bytes */
-    size = align_to_4(size);
+/*
+ * Payload address inside free segment 'seg' honouring 'align'. A
+ * misaligned start needs room for a leading free segment (header plus
+ * minimum payload) in front of the block.
+ */
+static uintptr_t aligned_payload(HeapSegment *seg, size_t align)
+{
+    uintptr_t start = (uintptr_t)seg + sizeof(HeapSegment);
+    uintptr_t addr = (start + align - 1) & ~(uintptr_t)(align - 1);
+
+    if (addr != start && addr - start < sizeof(HeapSegment) + 4)
+    {
+        addr = (start + sizeof(HeapSegment) + 4 + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    return addr;
+}
 
+/*
+ * Best-fit search: the smallest free segment that can satisfy 'size'
+ * at the requested alignment; its payload address goes to *addr_out.
+ */
+static HeapSegment *find_best_fit(size_t size, size_t align, uintptr_t *addr_out)
+{
     HeapSegment *best = NULL;
     HeapSegment *scan = heap_head_node;
 
-    /*
-     * 2. Best-fit search: find the smallest free segment that can satisfy size.
-     */
     while (scan)
     {
         if (scan->is_free && scan->length >= size)
         {
-            if (best == NULL || scan->length < best->length)
+            uintptr_t addr = aligned_payload(scan, align);
+            uintptr_t end = (uintptr_t)scan + sizeof(HeapSegment) + scan->length;
+
+            if (addr + size <= end &&
+                (best == NULL || scan->length < best->length))
             {
                 best = scan;
-            }
-            if (scan->length == size)
-            {
-                /* Perfect fit, we can stop early */
-                break;
+                *addr_out = addr;
+                if (scan->length == size)
+                {
+                    /* Perfect fit, we can stop early */
+                    break;
+                }
             }
         }
         scan = scan->link;
     }
+    return best;
+}
+
+/* Best-fit allocation of 'size' bytes whose payload is 'align'-aligned; caller holds heap_lock */
+static void *heap_alloc_internal(size_t size, size_t align, void *callsite)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    /* 1. Align requested size to 4 bytes */
+    size = align_to_4(size);
+
+    /* 2. Best-fit search */
+    uintptr_t best_addr = 0;
+    HeapSegment *best = find_best_fit(size, align, &best_addr);
+
+    if (best == NULL && heap_unmerged)
+    {
+        /* Deferred frees not merged yet: do it now rather than fail */
+        merge_adjacent_free_segments();
+        best = find_best_fit(size, align, &best_addr);
+    }
 
     if (best == NULL)
     {
-        /* No suitable free segment available */
+        /* No suitable free segment available; the caller may reclaim and retry */
         return NULL;
     }
 
     /*
-     * 3. Decide if we should split the segment.
-     * Only split when leftover is large enough for a header + some payload.
+     * 3. Carve a leading free segment if alignment pushed the payload up.
      */
-    const size_t min_payload = 4;
-    const size_t min_remainder = sizeof(HeapSegment) + min_payload;
-
-    if (best->length >= size + min_remainder)
+    uintptr_t start = (uintptr_t)best + sizeof(HeapSegment);
+    if (best_addr != start)
     {
-        uint8_t *base = (uint8_t *)best;
-        uint8_t *new_seg_addr = base + sizeof(HeapSegment) + size;
-
-        HeapSegment *split = (HeapSegment *)new_seg_addr;
-        split->length = best->length - size - sizeof(HeapSegment);
-        split->is_free = 1;
-        split->link = best->link;
+        HeapSegment *aligned = (HeapSegment *)(best_addr - sizeof(HeapSegment));
+        aligned->length = best->length - (best_addr - start);
+        aligned->link = best->link;
 
-        best->length = size;
-        best->link = split;
+        best->length = best_addr - start - sizeof(HeapSegment);
+        best->link = aligned;
+        best = aligned;
     }
 
+    /*
+     * 4. Split the tail if the leftover is worth keeping.
+     */
+    split_tail(best, size);
+
     best->is_free = 0;
+    best->owner = HEAP_OWNER_KERNEL; /* heap_set_owner() ties it to a process */
+
+    heap_counters.alloc_count++;
+    heap_counters.size_hist[size_bucket(size)]++;
+    heap_counters.bytes_in_use += best->length;
+    if (heap_counters.bytes_in_use > heap_counters.peak_in_use)
+    {
+        heap_counters.peak_in_use = heap_counters.bytes_in_use;
+    }
+
+#ifdef KACCHI_HEAP_DEBUG
+    tag_insert(best, callsite);
+#else
+    (void)callsite;
+#endif
 
     /* Return pointer to usable payload right after the header */
     return (uint8_t *)best + sizeof(HeapSegment);
 }
 
-void heap_free(void *ptr)
+/*
+ * Bytes not taken by live blocks or their headers; caller holds
+ * heap_lock. The headers of free segments still count as free, so
+ * this errs high by one header per free segment.
+ */
+static size_t heap_free_bytes(void)
+{
+    uint32_t live = heap_counters.alloc_count - heap_counters.free_count;
+    return HEAP_SIZE - heap_counters.bytes_in_use - live * sizeof(HeapSegment);
+}
+
+/* Failure accounting once reclaim could not help either; caller holds heap_lock */
+static void note_failure(size_t size)
+{
+    heap_counters.failed_allocs++;
+    trace_event(TRACE_ALLOC_FAIL, scheduler_current_pid(), (uint32_t)size);
+}
+
+/* Written under shrink_lock, which the allocation path does not take */
+static int shrinkers_registered(void)
+{
+    return __atomic_load_n(&shrinker_count, __ATOMIC_ACQUIRE) > 0;
+}
+
+/*
+ * heap_alloc_internal() with the lock taken; on failure run the
+ * shrinkers (they free, so heap_lock must be dropped) and try once more.
+ */
+static void *alloc_reclaiming(size_t size, size_t align, void *callsite)
+{
+    spin_lock(&heap_lock);
+    void *ptr = heap_alloc_internal(size, align, callsite);
+    int low = heap_free_bytes() < HEAP_LOW_WATERMARK;
+    spin_unlock(&heap_lock);
+
+    if (ptr == NULL && size != 0 && shrinkers_registered() && heap_reclaim(size + align) > 0)
+    {
+        spin_lock(&heap_lock);
+        ptr = heap_alloc_internal(size, align, callsite);
+        spin_unlock(&heap_lock);
+    }
+
+    if (ptr == NULL && size != 0)
+    {
+        spin_lock(&heap_lock);
+        note_failure(size);
+        spin_unlock(&heap_lock);
+    }
+    else if (low && shrinkers_registered())
+    {
+        work_queue(&reclaim_work);
+    }
+    return ptr;
+}
+
+void *heap_alloc(size_t size)
+{
+    return alloc_reclaiming(size, 4, __builtin_return_address(0));
+}
+
+void *heap_alloc_aligned(size_t size, size_t align)
+{
+    /* Power of two, and never weaker than the allocator's own 4 bytes */
+    if (align & (align - 1))
+    {
+        return NULL;
+    }
+    if (align < 4)
+    {
+        align = 4;
+    }
+
+    return alloc_reclaiming(size, align, __builtin_return_address(0));
+}
+
+void *heap_calloc(size_t count, size_t size)
+{
+    void *ptr = NULL;
+    if (size != 0 && count > (size_t)-1 / size)
+    {
+        spin_lock(&heap_lock);
+        heap_counters.failed_allocs++;
+        spin_unlock(&heap_lock);
+    }
+    else
+    {
+        ptr = alloc_reclaiming(count * size, 4, __builtin_return_address(0));
+    }
+
+    if (ptr)
+    {
+        /* Payload is a multiple of 4, so memset runs as whole-word stores */
+        memset(ptr, 0, align_to_4(count * size));
+    }
+    return ptr;
+}
+
+/* heap_free() body; caller holds heap_lock */
+static void free_locked(void *ptr)
 {
     if (ptr == NULL)
     {
@@ -183,7 +487,12 @@ void heap_free(void *ptr)
      * Recover header from payload pointer.
      */
     HeapSegment *seg = (HeapSegment *)((uint8_t *)ptr - sizeof(HeapSegment));
-    seg->is_free = 1;
+    if (seg->is_free)
+    {
+        /* Double free: nothing to release, keep the counters honest */
+        return;
+    }
+    release_segment(seg);
 
     /*
      * Perform full coalescing of adjacent free segments.
@@ -191,6 +500,453 @@ void heap_free(void *ptr)
     merge_adjacent_free_segments();
 }
 
+/* heap_set_owner() body; caller holds heap_lock */
+static void set_owner_locked(void *ptr, int32_t owner)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    HeapSegment *seg = (HeapSegment *)((uint8_t *)ptr - sizeof(HeapSegment));
+    seg->owner = (int16_t)owner;
+
+#ifdef KACCHI_HEAP_DEBUG
+    uint16_t offset = (uint16_t)((uint8_t *)seg - g_heap_store);
+    for (int i = 0; i < HEAP_DEBUG_SLOTS; i++)
+    {
+        if (heap_tags[i].offset == offset)
+        {
+            heap_tags[i].pid = (int16_t)owner;
+            break;
+        }
+    }
+#endif
+}
+
+static void *realloc_locked(void *ptr, size_t size, void *callsite)
+{
+    if (ptr == NULL)
+    {
+        void *fresh = heap_alloc_internal(size, 4, callsite);
+        if (fresh == NULL && size != 0)
+        {
+            note_failure(size);
+        }
+        return fresh;
+    }
+    if (size == 0)
+    {
+        free_locked(ptr);
+        return NULL;
+    }
+
+    size = align_to_4(size);
+    HeapSegment *seg = (HeapSegment *)((uint8_t *)ptr - sizeof(HeapSegment));
+    size_t old_length = seg->length;
+
+    /* Grow in place by absorbing a free right-hand neighbour */
+    HeapSegment *next = seg->link;
+    if (size > seg->length && next && next->is_free &&
+        seg->length + sizeof(HeapSegment) + next->length >= size)
+    {
+        seg->length += sizeof(HeapSegment) + next->length;
+        seg->link = next->link;
+    }
+
+    if (size <= seg->length)
+    {
+        /* Shrink (or trim the absorbed neighbour) in place */
+        split_tail(seg, size);
+        heap_counters.bytes_in_use += seg->length;
+        heap_counters.bytes_in_use -= old_length;
+        if (heap_counters.bytes_in_use > heap_counters.peak_in_use)
+        {
+            heap_counters.peak_in_use = heap_counters.bytes_in_use;
+        }
+        if (seg->link && seg->link->is_free)
+        {
+            merge_adjacent_free_segments();
+        }
+        return ptr;
+    }
+
+    /* No room next door: move the block */
+    void *moved = heap_alloc_internal(size, 4, callsite);
+    if (moved == NULL)
+    {
+        note_failure(size);
+        return NULL;
+    }
+    memcpy(moved, ptr, seg->length);
+    set_owner_locked(moved, seg->owner);
+    free_locked(ptr);
+    return moved;
+}
+
+void *heap_realloc(void *ptr, size_t size)
+{
+    spin_lock(&heap_lock);
+    void *result = realloc_locked(ptr, size, __builtin_return_address(0));
+    spin_unlock(&heap_lock);
+    return result;
+}
+
+void heap_free(void *ptr)
+{
+    spin_lock(&heap_lock);
+    free_locked(ptr);
+    spin_unlock(&heap_lock);
+}
+
+void heap_release(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    spin_lock(&heap_lock);
+    HeapSegment *seg = (HeapSegment *)((uint8_t *)ptr - sizeof(HeapSegment));
+    if (!seg->is_free)
+    {
+        release_segment(seg);
+        heap_unmerged = 1;
+    }
+    spin_unlock(&heap_lock);
+}
+
+void heap_free_deferred(void *ptr)
+{
+    heap_release(ptr);
+    work_queue(&coalesce_work);
+}
+
+static void coalesce_work_fn(work_t *work)
+{
+    (void)work;
+    heap_coalesce();
+}
+
+void heap_coalesce(void)
+{
+    spin_lock(&heap_lock);
+    merge_adjacent_free_segments();
+    spin_unlock(&heap_lock);
+}
+
+/* ---------------- Reclaim under memory pressure ------------------------- */
+
+int heap_register_shrinker(const char *name, int priority, heap_shrink_fn fn)
+{
+    spin_lock(&shrink_lock);
+    if (shrinker_count == HEAP_MAX_SHRINKERS || fn == NULL)
+    {
+        spin_unlock(&shrink_lock);
+        return -1;
+    }
+
+    /* Insertion keeps the table sorted; equal priorities run in registration order */
+    int at = shrinker_count;
+    while (at > 0 && shrinkers[at - 1].priority > priority)
+    {
+        shrinkers[at] = shrinkers[at - 1];
+        at--;
+    }
+    shrinkers[at] = (Shrinker){name, priority, fn, 0, 0};
+    __atomic_store_n(&shrinker_count, shrinker_count + 1, __ATOMIC_RELEASE);
+    spin_unlock(&shrink_lock);
+    return 0;
+}
+
+size_t heap_reclaim(size_t want)
+{
+    size_t got = 0;
+
+    spin_lock(&shrink_lock);
+    for (int i = 0; i < shrinker_count && got < want; i++)
+    {
+        size_t freed = shrinkers[i].fn(want - got);
+        shrinkers[i].calls++;
+        shrinkers[i].reclaimed += freed;
+        got += freed;
+    }
+    spin_unlock(&shrink_lock);
+
+    /* A reclaimed block next to a free one only fits a large request once merged */
+    if (got > 0)
+    {
+        heap_coalesce();
+    }
+    return got;
+}
+
+static void reclaim_work_fn(work_t *work)
+{
+    (void)work;
+
+    spin_lock(&heap_lock);
+    size_t free_bytes = heap_free_bytes();
+    spin_unlock(&heap_lock);
+
+    if (free_bytes < HEAP_HIGH_WATERMARK)
+    {
+        heap_reclaim(HEAP_HIGH_WATERMARK - free_bytes);
+    }
+}
+
+void heap_print_shrinkers(void)
+{
+    spin_lock(&shrink_lock);
+    for (int i = 0; i < shrinker_count; i++)
+    {
+        serial_puts("    ");
+        serial_puts(shrinkers[i].name);
+        serial_puts(" (priority ");
+        serial_put_dec((uint32_t)shrinkers[i].priority);
+        serial_puts("): ");
+        serial_put_dec(shrinkers[i].calls);
+        serial_puts(" calls, ");
+        serial_put_dec(shrinkers[i].reclaimed);
+        serial_puts(" bytes\n");
+    }
+    spin_unlock(&shrink_lock);
+}
+
+/* ---------------- Ownership / leak tracking ----------------------------- */
+
+void heap_set_owner(void *ptr, int32_t owner)
+{
+    spin_lock(&heap_lock);
+    set_owner_locked(ptr, owner);
+    spin_unlock(&heap_lock);
+}
+
+void heap_bytes_by_owner(size_t *bytes, int32_t count)
+{
+    for (int32_t i = 0; i < count; i++)
+    {
+        bytes[i] = 0;
+    }
+
+    spin_lock(&heap_lock);
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        if (!node->is_free && node->owner >= 0 && node->owner < count)
+        {
+            bytes[node->owner] += node->length;
+        }
+    }
+    spin_unlock(&heap_lock);
+}
+
+size_t heap_release_owner(int32_t owner)
+{
+    size_t reclaimed = 0;
+
+    spin_lock(&heap_lock);
+
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        if (!node->is_free && node->owner == owner)
+        {
+            reclaimed += node->length;
+            release_segment(node);
+        }
+    }
+
+    /* One coalescing pass for the whole batch instead of one per block */
+    if (reclaimed)
+    {
+        merge_adjacent_free_segments();
+    }
+    spin_unlock(&heap_lock);
+    return reclaimed;
+}
+
+#define LEAK_GROUPS 16
+
+typedef struct
+{
+    uint32_t key;
+    uint32_t bytes;
+    uint32_t blocks;
+} LeakGroup;
+
+/* Accumulate into the group for 'key'; overflow lands in the last group */
+static void leak_account(LeakGroup *groups, int *used, uint32_t key, size_t bytes)
+{
+    int i;
+    for (i = 0; i < *used; i++)
+    {
+        if (groups[i].key == key)
+        {
+            break;
+        }
+    }
+    if (i == *used)
+    {
+        if (*used == LEAK_GROUPS)
+        {
+            i = LEAK_GROUPS - 1;
+        }
+        else
+        {
+            groups[i].key = key;
+            groups[i].bytes = 0;
+            groups[i].blocks = 0;
+            (*used)++;
+        }
+    }
+    groups[i].bytes += bytes;
+    groups[i].blocks++;
+}
+
+static void leak_print_group(const LeakGroup *g)
+{
+    serial_put_dec(g->bytes);
+    serial_puts(" bytes in ");
+    serial_put_dec(g->blocks);
+    serial_puts(" block(s)\n");
+}
+
+void heap_report_leaks(void)
+{
+    LeakGroup by_owner[LEAK_GROUPS];
+    int owners = 0;
+#ifdef KACCHI_HEAP_DEBUG
+    LeakGroup by_site[LEAK_GROUPS];
+    int sites = 0;
+    uint32_t untagged;
+#endif
+
+    /* Group under the lock, print after: serial output must not stall allocations */
+    spin_lock(&heap_lock);
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        if (!node->is_free)
+        {
+            leak_account(by_owner, &owners, (uint32_t)(int32_t)node->owner, node->length);
+        }
+    }
+#ifdef KACCHI_HEAP_DEBUG
+    for (int i = 0; i < HEAP_DEBUG_SLOTS; i++)
+    {
+        if (heap_tags[i].offset != HEAP_DEBUG_EMPTY)
+        {
+            HeapSegment *seg = (HeapSegment *)(g_heap_store + heap_tags[i].offset);
+            leak_account(by_site, &sites, heap_tags[i].callsite, seg->length);
+        }
+    }
+    untagged = heap_untagged;
+#endif
+    spin_unlock(&heap_lock);
+
+    serial_puts("Outstanding heap blocks by owner:\n");
+    if (owners == 0)
+    {
+        serial_puts("  (none)\n");
+    }
+    for (int i = 0; i < owners; i++)
+    {
+        int32_t owner = (int32_t)by_owner[i].key;
+        if (owner == HEAP_OWNER_KERNEL)
+        {
+            serial_puts("  kernel  : ");
+        }
+        else
+        {
+            serial_puts("  PID ");
+            serial_put_dec((uint32_t)owner);
+            serial_puts("   : ");
+        }
+        leak_print_group(&by_owner[i]);
+    }
+
+#ifdef KACCHI_HEAP_DEBUG
+    serial_puts("Outstanding heap blocks by callsite:\n");
+    for (int i = 0; i < sites; i++)
+    {
+        serial_puts("  ");
+        serial_put_hex(by_site[i].key);
+        serial_puts(": ");
+        leak_print_group(&by_site[i]);
+    }
+    if (untagged)
+    {
+        serial_puts("  (");
+        serial_put_dec(untagged);
+        serial_puts(" allocations not tagged: side table full)\n");
+    }
+#else
+    serial_puts("(rebuild with 'make HEAP_DEBUG=1' for per-callsite totals)\n");
+#endif
+}
+
+/* ---------------- Telemetry ------------------------------------------- */
+
+void heap_get_stats(HeapStats *out)
+{
+    spin_lock(&heap_lock);
+    *out = heap_counters;
+    out->bytes_free = 0;
+    out->largest_free = 0;
+    out->free_segments = 0;
+    out->used_segments = 0;
+    out->stack_in_use = stack_marker;
+
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        if (node->is_free)
+        {
+            out->free_segments++;
+            out->bytes_free += node->length;
+            if (node->length > out->largest_free)
+            {
+                out->largest_free = node->length;
+            }
+        }
+        else
+        {
+            out->used_segments++;
+        }
+    }
+
+    /* 0 when all free memory is one block, approaching 1000 as it splinters */
+    out->fragmentation = 0;
+    if (out->bytes_free > 0)
+    {
+        out->fragmentation = 1000 - (out->largest_free * 1000) / out->bytes_free;
+    }
+    spin_unlock(&heap_lock);
+}
+
+size_t heap_write_snapshot(void)
+{
+    spin_lock(&heap_lock);
+    uint16_t count = 0;
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        count++;
+    }
+
+    uint32_t magic = HEAP_SNAPSHOT_MAGIC;
+    uint16_t header[2] = {(uint16_t)HEAP_SIZE, count};
+    serial_write(&magic, sizeof(magic));
+    serial_write(header, sizeof(header));
+
+    for (HeapSegment *node = heap_head_node; node; node = node->link)
+    {
+        uint16_t rec[2];
+        rec[0] = (uint16_t)((uint8_t *)node - g_heap_store);
+        rec[1] = (uint16_t)node->length | (node->is_free ? 0x8000 : 0);
+        serial_write(rec, sizeof(rec));
+    }
+    spin_unlock(&heap_lock);
+
+    return sizeof(magic) + sizeof(header) + (size_t)count * 4;
+}
+
 /* -------------------- Stress / validation routine ---------------------- */
 
 void stress_test_memory(void)
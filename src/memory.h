@@ -28,12 +28,58 @@ extern uint8_t g_heap_store[HEAP_SIZE];
 typedef struct HeapSegment
 {
     size_t length;            /* size of the usable payload in bytes */
-    int is_free;              /* non-zero if this segment is free */
+    uint16_t is_free;         /* non-zero if this segment is free */
+    int16_t owner;            /* PID it was tagged to, HEAP_OWNER_KERNEL otherwise */
     struct HeapSegment *link; /* next segment in the heap list */
 } HeapSegment;
 
 typedef HeapSegment MemBlock;
 
+/*
+ * Owner of every block until heap_set_owner() tags it to a process.
+ * Allocating while a process runs does not tag it: kernel objects
+ * made then (work items, channel buffers) may outlive that process.
+ */
+#define HEAP_OWNER_KERNEL (-1)
+
+/*
+ * Debug builds (make HEAP_DEBUG=1) additionally record the return
+ * address of every heap_alloc caller in a side table so 'leaks' can
+ * group outstanding bytes by callsite.
+ */
+#define HEAP_DEBUG_SLOTS 128
+
+/*
+ * Allocation size histogram: bucket i counts requests of at most
+ * (16 << i) bytes; the last bucket catches everything larger.
+ */
+#define HEAP_HIST_BUCKETS 9
+
+/*
+ * Heap telemetry. Counters are maintained on every alloc/free; the
+ * segment-shape fields (free bytes, largest block, segment counts)
+ * are gathered by a walk of the segment list when the snapshot is taken.
+ */
+typedef struct
+{
+    size_t heap_total;         /* bytes managed, headers included */
+    size_t bytes_in_use;       /* payload bytes in allocated segments */
+    size_t bytes_free;         /* payload bytes in free segments */
+    size_t largest_free;       /* biggest single free payload */
+    size_t peak_in_use;        /* high-water mark of bytes_in_use */
+    uint32_t free_segments;
+    uint32_t used_segments;
+    uint32_t alloc_count;      /* successful heap_alloc calls */
+    uint32_t free_count;       /* heap_free calls on live blocks */
+    uint32_t failed_allocs;    /* heap_alloc calls that returned NULL */
+    uint32_t fragmentation;    /* 1 - largest_free/bytes_free, in 1/1000 */
+    uint32_t size_hist[HEAP_HIST_BUCKETS];
+    size_t stack_in_use;       /* bytes held by the linear stack allocator */
+} HeapStats;
+
+/* Binary snapshot format streamed by heap_write_snapshot() */
+#define HEAP_SNAPSHOT_MAGIC 0x314E5348u /* "HSN1" little-endian */
+
 /* ----------------------------------------------------------------------------
  * Public interface
  * ----------------------------------------------------------------------------
@@ -50,6 +96,83 @@ void stack_free(size_t size);
 void *heap_alloc(size_t size);
 void heap_free(void *ptr);
 
+/* Payload aligned to 'align' (a power of two, e.g. 64 for a cache line). */
+void *heap_alloc_aligned(size_t size, size_t align);
+
+/* Zeroed array of 'count' elements; NULL on overflow or exhaustion. */
+void *heap_calloc(size_t count, size_t size);
+
+/*
+ * Resize a block, growing in place into a free next neighbour when
+ * possible and copying only when it has to move.
+ */
+void *heap_realloc(void *ptr, size_t size);
+
+/*
+ * Batch release: heap_release() frees without merging neighbours, then a
+ * single heap_coalesce() tidies the whole list.
+ */
+void heap_release(void *ptr);
+void heap_coalesce(void);
+
+/*
+ * heap_release() now, coalescing later on the work-queue worker (one
+ * pass however many frees pile up). An allocation that would fail
+ * merges on the spot instead, so nothing is lost by deferring.
+ */
+void heap_free_deferred(void *ptr);
+
+/*
+ * Memory-pressure reclaim. A cache holding heap memory it can do
+ * without (pooled save areas and the like) registers a shrinker. When
+ * an allocation fails the heap runs the shrinkers in priority order,
+ * lowest first, until enough came back, then retries once. An
+ * allocation leaving less than HEAP_LOW_WATERMARK free queues the same
+ * on the work-queue worker, refilling to HEAP_HIGH_WATERMARK before the
+ * next request has to fail. Shrinkers may free but never allocate, and
+ * return the payload bytes they gave back.
+ */
+#define HEAP_MAX_SHRINKERS 8
+#define HEAP_LOW_WATERMARK (HEAP_SIZE / 8)
+#define HEAP_HIGH_WATERMARK (HEAP_SIZE / 4)
+
+typedef size_t (*heap_shrink_fn)(size_t want);
+
+/* 0 on success, -1 if the table is full */
+int heap_register_shrinker(const char *name, int priority, heap_shrink_fn fn);
+
+/* Ask the shrinkers for 'want' bytes; returns what they released */
+size_t heap_reclaim(size_t want);
+
+/* Per-shrinker calls and bytes reclaimed */
+void heap_print_shrinkers(void);
+
+/* Re-tag a live block, e.g. to have heap_release_owner() reclaim it with its process. */
+void heap_set_owner(void *ptr, int32_t owner);
+
+/* bytes[pid] = payload bytes of live blocks tagged with pid, for pid < count. */
+void heap_bytes_by_owner(size_t *bytes, int32_t count);
+
+/*
+ * Free every block tagged with 'owner' and coalesce once.
+ * Returns the number of payload bytes reclaimed.
+ */
+size_t heap_release_owner(int32_t owner);
+
+/* Print outstanding blocks grouped by owner (and by callsite in debug builds). */
+void heap_report_leaks(void);
+
+/* Fill 'out' with current heap counters and a fresh segment walk. */
+void heap_get_stats(HeapStats *out);
+
+/*
+ * Stream the segment list over serial as a compact little-endian record:
+ *   u32 magic, u16 heap_size, u16 segment_count,
+ *   then per segment: u16 offset, u16 length | 0x8000 if free.
+ * Returns the number of bytes written.
+ */
+size_t heap_write_snapshot(void);
+
 /* Optional diagnostic routine to exercise the allocator. */
 void stress_test_memory(void);
 
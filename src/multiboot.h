@@ -0,0 +1,34 @@
+/* multiboot.h - Boot information handed over by a Multiboot (v1) loader */
+#ifndef KACCHI_MULTIBOOT_H
+#define KACCHI_MULTIBOOT_H
+
+#include "types.h"
+
+/* EAX at entry when a compliant loader started us */
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002u
+
+/* multiboot_info_t.flags: which fields are valid */
+#define MULTIBOOT_INFO_CMDLINE (1u << 2)
+#define MULTIBOOT_INFO_MODS (1u << 3)
+
+/* Leading fields only; nothing here reads the rest */
+typedef struct
+{
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;    /* physical address of a NUL-terminated string */
+    uint32_t mods_count;
+    uint32_t mods_addr;  /* physical address of mods_count multiboot_module_t */
+} multiboot_info_t;
+
+typedef struct
+{
+    uint32_t mod_start; /* physical [mod_start, mod_end) */
+    uint32_t mod_end;
+    uint32_t string;    /* the module's command line, usually its path */
+    uint32_t reserved;
+} multiboot_module_t;
+
+#endif /* KACCHI_MULTIBOOT_H */
@@ -0,0 +1,655 @@
+/* paging.c - Frame allocator, page tables and per-process address spaces */
+#include "paging.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "idt.h"
+#include "memory.h"
+#include "process.h"
+#include "serial.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "string.h"
+
+#define FRAME_COUNT ((FRAME_POOL_END - FRAME_POOL_START) / PAGE_SIZE)
+#define PDE_INDEX(va) ((va) >> 22)
+#define PTE_INDEX(va) (((va) >> 12) & 0x3FF)
+
+/* Scratch window used only by the TLB benchmark */
+#define TLB_BENCH_VA 0xE0000000u
+#define TLB_BENCH_PAGES 16
+#define TLB_BENCH_ROUNDS 64
+
+static uint32_t kernel_dir[1024] __attribute__((aligned(4096)));
+static uint32_t low_table[1024] __attribute__((aligned(4096))); /* first 4 MB */
+static uint32_t *current_dirs[MAX_CPUS]; /* what each CPU's CR3 holds */
+
+/* Reference count per pool frame (0 = free) */
+static uint8_t frame_refs[FRAME_COUNT];
+
+/* One bit per pool frame, set when in use */
+static uint32_t frame_bitmap[FRAME_COUNT / 32];
+static uint32_t frame_hint = 0; /* first word that may have a clear bit */
+static uint32_t frames_free = FRAME_COUNT;
+static spinlock_t frame_lock = SPINLOCK_INIT; /* bitmap, counts and refs */
+
+/* Stack for the double-fault task (see df_task_entry in isr.S) */
+static uint8_t fault_stack[4096] __attribute__((aligned(16)));
+extern void df_task_entry(void);
+
+/* Section bounds from link.ld */
+extern uint8_t __user_text_start[], __user_text_end[];
+extern uint8_t __ushared_start[], __ushared_end[];
+
+/* ---------------- Frame allocator ------------------------------------- */
+
+uint32_t frame_alloc(void)
+{
+    spin_lock(&frame_lock);
+    for (uint32_t w = frame_hint; w < FRAME_COUNT / 32; w++)
+    {
+        if (frame_bitmap[w] == 0xFFFFFFFFu)
+        {
+            continue;
+        }
+
+        uint32_t bit = 0;
+        while (frame_bitmap[w] & (1u << bit))
+        {
+            bit++;
+        }
+
+        frame_bitmap[w] |= 1u << bit;
+        frame_hint = w;
+        frames_free--;
+
+        frame_refs[w * 32 + bit] = 1;
+        spin_unlock(&frame_lock);
+
+        uint32_t phys = FRAME_POOL_START + (w * 32 + bit) * PAGE_SIZE;
+        memset((void *)phys, 0, PAGE_SIZE);
+        return phys;
+    }
+    spin_unlock(&frame_lock);
+    return 0;
+}
+
+void frame_ref(uint32_t phys)
+{
+    if (phys >= FRAME_POOL_START && phys < FRAME_POOL_END)
+    {
+        spin_lock(&frame_lock);
+        uint32_t index = (phys - FRAME_POOL_START) / PAGE_SIZE;
+        if (frame_refs[index] != 0) /* reserved frames are not counted */
+        {
+            frame_refs[index]++;
+        }
+        spin_unlock(&frame_lock);
+    }
+}
+
+void frame_reserve(uint32_t start, uint32_t end)
+{
+    spin_lock(&frame_lock);
+    for (uint32_t page = start & PTE_FRAME; page < end; page += PAGE_SIZE)
+    {
+        if (page < FRAME_POOL_START || page >= FRAME_POOL_END)
+        {
+            continue;
+        }
+
+        uint32_t index = (page - FRAME_POOL_START) / PAGE_SIZE;
+        if (!(frame_bitmap[index / 32] & (1u << (index % 32))))
+        {
+            frame_bitmap[index / 32] |= 1u << (index % 32);
+            frames_free--;
+        }
+    }
+    spin_unlock(&frame_lock);
+}
+
+void frame_free(uint32_t phys)
+{
+    if (phys < FRAME_POOL_START || phys >= FRAME_POOL_END)
+    {
+        return;
+    }
+
+    uint32_t index = (phys - FRAME_POOL_START) / PAGE_SIZE;
+    uint32_t w = index / 32;
+    uint32_t mask = 1u << (index % 32);
+
+    spin_lock(&frame_lock);
+    if (frame_refs[index] == 0 || --frame_refs[index] > 0)
+    {
+        spin_unlock(&frame_lock);
+        return; /* stray free, or still shared */
+    }
+
+    if (frame_bitmap[w] & mask)
+    {
+        frame_bitmap[w] &= ~mask;
+        frames_free++;
+        if (w < frame_hint)
+        {
+            frame_hint = w;
+        }
+    }
+    spin_unlock(&frame_lock);
+}
+
+uint32_t frame_free_count(void)
+{
+    return frames_free;
+}
+
+/* ---------------- Fault handlers -------------------------------------- */
+
+/*
+ * Ordinary interrupt gate: a fault in ring 3 arrives on the process's
+ * kernel stack, so only faults on that stack itself escalate to the
+ * double-fault task below.
+ */
+static void page_fault_handler(isr_frame_t *frame)
+{
+    uint32_t addr = read_cr2();
+
+    if (proc_handle_fault(addr, frame->error, frame) == 0)
+    {
+        return;
+    }
+
+    serial_puts("\n[PANIC] Page fault at ");
+    serial_put_hex(addr);
+    serial_puts(" (error ");
+    serial_put_hex(frame->error);
+    serial_puts(") EIP ");
+    serial_put_hex(frame->eip);
+    serial_puts("\n");
+    cpu_halt();
+}
+
+/*
+ * Runs as its own hardware task, so a kernel stack overflow (guard
+ * page) still has a good stack to report from. The interrupted context
+ * sits in the main TSS.
+ */
+void double_fault_task(uint32_t error)
+{
+    tss_t *ctx = gdt_faulted_tss();
+
+    serial_puts("\n[PANIC] Double fault (error ");
+    serial_put_hex(error);
+    serial_puts(") EIP ");
+    serial_put_hex(ctx->eip);
+    serial_puts(" ESP ");
+    serial_put_hex(ctx->esp);
+    serial_puts("\n");
+    cpu_halt();
+}
+
+/* ---------------- Page tables ----------------------------------------- */
+
+static uint32_t *pte_for(uint32_t *dir, uint32_t va, int create);
+
+void paging_init(void)
+{
+    /*
+     * First 4 MB in 4 KB pages so ring 3 sees only what it needs: the
+     * kernel text (user code lives there too) read-only and the .ushared
+     * test page read-write. Page 0 stays unmapped to catch NULL.
+     */
+    for (uint32_t i = 1; i < 1024; i++)
+    {
+        uint32_t pa = i * PAGE_SIZE;
+        uint32_t flags = PTE_GLOBAL | PTE_WRITE | PTE_PRESENT;
+
+        if (pa >= (uint32_t)__user_text_start && pa < (uint32_t)__user_text_end)
+            flags = PTE_GLOBAL | PTE_USER | PTE_PRESENT;
+        else if (pa >= (uint32_t)__ushared_start && pa < (uint32_t)__ushared_end)
+            flags |= PTE_USER;
+
+        low_table[i] = pa | flags;
+    }
+    kernel_dir[0] = (uint32_t)low_table | PTE_USER | PTE_WRITE | PTE_PRESENT;
+
+    /*
+     * The kernel heap holds state ring 3 must never forge (FXSAVE areas,
+     * segment headers), so no page of it may share a user page.
+     */
+    for (uint32_t va = (uint32_t)g_heap_store & PTE_FRAME; va < (uint32_t)g_heap_store + HEAP_SIZE;
+         va += PAGE_SIZE)
+    {
+        if (paging_user_ok(kernel_dir, va, 1, 0))
+        {
+            serial_puts("\n[PANIC] Kernel heap page ");
+            serial_put_hex(va);
+            serial_puts(" is user-accessible\n");
+            cpu_halt();
+        }
+    }
+
+    /* Rest of the identity map in 4 MB global pages: few TLB entries, never flushed */
+    for (uint32_t i = 1; i < PAGING_IDENTITY_BYTES / LARGE_PAGE_SIZE; i++)
+    {
+        kernel_dir[i] = (i * LARGE_PAGE_SIZE) | PTE_LARGE | PTE_GLOBAL | PTE_WRITE | PTE_PRESENT;
+    }
+
+    write_cr4(read_cr4() | CR4_PSE | CR4_PGE);
+    write_cr3((uint32_t)kernel_dir);
+    /* WP: ring-0 writes honour read-only PTEs too, so COW catches them */
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        current_dirs[cpu] = kernel_dir; /* APs start on it too */
+    }
+
+    idt_set_handler(14, page_fault_handler);
+    gdt_set_fault_task(df_task_entry, fault_stack + sizeof(fault_stack), (uint32_t)kernel_dir);
+    idt_set_task_gate(8, GDT_FAULT_TSS);
+}
+
+uint32_t *paging_kernel_dir(void)
+{
+    return kernel_dir;
+}
+
+uint32_t *paging_create_space(void)
+{
+    uint32_t *dir = (uint32_t *)frame_alloc();
+    if (dir == NULL)
+    {
+        return NULL;
+    }
+
+    /* Share the kernel half; the frame arrives zeroed for the rest */
+    for (int i = 0; i < 1024; i++)
+    {
+        dir[i] = kernel_dir[i];
+    }
+    return dir;
+}
+
+uint32_t *paging_clone_space(uint32_t *parent)
+{
+    uint32_t *dir = paging_create_space();
+    if (dir == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < 1024; i++)
+    {
+        if (!(parent[i] & PTE_PRESENT) || parent[i] == kernel_dir[i] || (parent[i] & PTE_LARGE))
+        {
+            continue;
+        }
+
+        uint32_t table = frame_alloc();
+        if (table == 0)
+        {
+            paging_destroy_space(dir);
+            return NULL;
+        }
+
+        dir[i] = table | (parent[i] & ~PTE_FRAME);
+
+        uint32_t *src = (uint32_t *)(parent[i] & PTE_FRAME);
+        uint32_t *dst = (uint32_t *)table;
+        for (int j = 0; j < 1024; j++)
+        {
+            if (!(src[j] & PTE_PRESENT))
+            {
+                continue;
+            }
+            if (!(src[j] & PTE_USER))
+            {
+                /*
+                 * Supervisor pages (the kernel stack) are copied now: the
+                 * CPU pushes fault frames onto that stack, so it can never
+                 * be the one taking a copy-on-write fault.
+                 */
+                uint32_t copy = frame_alloc();
+                if (copy == 0)
+                {
+                    paging_destroy_space(dir);
+                    return NULL;
+                }
+                memcpy((void *)copy, (const void *)(src[j] & PTE_FRAME), PAGE_SIZE);
+                dst[j] = copy | (src[j] & ~PTE_FRAME);
+                continue;
+            }
+            if (src[j] & PTE_WRITE)
+            {
+                src[j] = (src[j] & ~PTE_WRITE) | PTE_COW;
+            }
+            dst[j] = src[j];
+            frame_ref(src[j] & PTE_FRAME);
+        }
+    }
+
+    /* The parent lost write access to pages it may have cached */
+    if (parent == paging_current())
+    {
+        write_cr3((uint32_t)parent);
+    }
+    return dir;
+}
+
+int paging_resolve_cow(uint32_t *dir, uint32_t va)
+{
+    uint32_t *pte = pte_for(dir, va, 0);
+    if (pte == NULL || (*pte & (PTE_PRESENT | PTE_COW)) != (PTE_PRESENT | PTE_COW))
+    {
+        return -1;
+    }
+
+    uint32_t old = *pte & PTE_FRAME;
+    uint32_t flags = (*pte & ~(PTE_FRAME | PTE_COW)) | PTE_WRITE;
+
+    if (old >= FRAME_POOL_START && old < FRAME_POOL_END &&
+        frame_refs[(old - FRAME_POOL_START) / PAGE_SIZE] == 1)
+    {
+        /* Last sharer: just take the page back (no one can add a reference) */
+        *pte = old | flags;
+    }
+    else
+    {
+        uint32_t copy = frame_alloc();
+        if (copy == 0)
+        {
+            return -1;
+        }
+        memcpy((void *)copy, (const void *)old, PAGE_SIZE);
+        *pte = copy | flags;
+        frame_free(old);
+    }
+
+    if (dir == paging_current())
+    {
+        invlpg(va);
+    }
+    return 0;
+}
+
+void paging_destroy_space(uint32_t *dir)
+{
+    if (dir == NULL || dir == kernel_dir)
+    {
+        return;
+    }
+
+    for (int i = 0; i < 1024; i++)
+    {
+        /* Skip shared kernel entries and large pages */
+        if (!(dir[i] & PTE_PRESENT) || dir[i] == kernel_dir[i] || (dir[i] & PTE_LARGE))
+        {
+            continue;
+        }
+
+        uint32_t *table = (uint32_t *)(dir[i] & PTE_FRAME);
+        for (int j = 0; j < 1024; j++)
+        {
+            if (table[j] & PTE_PRESENT)
+            {
+                frame_free(table[j] & PTE_FRAME);
+            }
+        }
+        frame_free((uint32_t)table);
+    }
+
+    frame_free((uint32_t)dir);
+}
+
+/* Page table entry for 'va', allocating the table when 'create' is set */
+static uint32_t *pte_for(uint32_t *dir, uint32_t va, int create)
+{
+    uint32_t *pde = &dir[PDE_INDEX(va)];
+
+    if (!(*pde & PTE_PRESENT))
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+        uint32_t table = frame_alloc();
+        if (table == 0)
+        {
+            return NULL;
+        }
+        /* Leaf entries decide the real permissions */
+        *pde = table | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    }
+    else if (*pde & PTE_LARGE)
+    {
+        return NULL;
+    }
+
+    uint32_t *table = (uint32_t *)(*pde & PTE_FRAME);
+    return &table[PTE_INDEX(va)];
+}
+
+int paging_map(uint32_t *dir, uint32_t va, uint32_t pa, uint32_t flags)
+{
+    uint32_t *pte = pte_for(dir, va, 1);
+    if (pte == NULL)
+    {
+        return -1;
+    }
+
+    *pte = (pa & PTE_FRAME) | flags | PTE_PRESENT;
+    if (dir == paging_current())
+    {
+        invlpg(va);
+    }
+    return 0;
+}
+
+uint32_t paging_unmap(uint32_t *dir, uint32_t va)
+{
+    uint32_t *pte = pte_for(dir, va, 0);
+    if (pte == NULL || !(*pte & PTE_PRESENT))
+    {
+        return 0;
+    }
+
+    uint32_t frame = *pte & PTE_FRAME;
+    *pte = 0;
+    if (dir == paging_current())
+    {
+        invlpg(va);
+    }
+    return frame;
+}
+
+int paging_map_identity(uint32_t pa, uint32_t len, uint32_t flags)
+{
+    uint32_t pages = ((pa & ~PTE_FRAME) + len + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (uint32_t i = 0; i < pages; i++)
+    {
+        uint32_t page = (pa & PTE_FRAME) + i * PAGE_SIZE;
+        if (page < PAGING_IDENTITY_BYTES)
+        {
+            continue; /* already covered by the shared identity map */
+        }
+        if (paging_lookup(kernel_dir, page) == page)
+        {
+            continue;
+        }
+        if (paging_map(kernel_dir, page, page, flags | PTE_GLOBAL) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+uint32_t paging_lookup(uint32_t *dir, uint32_t va)
+{
+    uint32_t pde = dir[PDE_INDEX(va)];
+    if (!(pde & PTE_PRESENT))
+    {
+        return 0;
+    }
+    if (pde & PTE_LARGE)
+    {
+        return (pde & 0xFFC00000u) | (va & (LARGE_PAGE_SIZE - 1));
+    }
+
+    uint32_t pte = ((uint32_t *)(pde & PTE_FRAME))[PTE_INDEX(va)];
+    if (!(pte & PTE_PRESENT))
+    {
+        return 0;
+    }
+    return (pte & PTE_FRAME) | (va & (PAGE_SIZE - 1));
+}
+
+void paging_switch(uint32_t *dir)
+{
+    if (dir == paging_current())
+    {
+        return;
+    }
+
+    current_dirs[smp_cpu_id()] = dir;
+    write_cr3((uint32_t)dir);
+}
+
+int paging_user_ok(uint32_t *dir, uint32_t va, uint32_t len, int write)
+{
+    if (len == 0)
+    {
+        return 1;
+    }
+    if (va + len < va)
+    {
+        return 0;
+    }
+
+    for (uint32_t page = va & PTE_FRAME; page < va + len; page += PAGE_SIZE)
+    {
+        uint32_t pde = dir[PDE_INDEX(page)];
+        if ((pde & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER) || (pde & PTE_LARGE))
+        {
+            return 0;
+        }
+
+        uint32_t pte = ((uint32_t *)(pde & PTE_FRAME))[PTE_INDEX(page)];
+        if ((pte & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER))
+        {
+            return 0;
+        }
+        /* A COW page is writable: the kernel's own write resolves it */
+        if (write && !(pte & (PTE_WRITE | PTE_COW)))
+        {
+            return 0;
+        }
+        if (page == PTE_FRAME)
+        {
+            break; /* last page of the address space */
+        }
+    }
+    return 1;
+}
+
+uint32_t *paging_current(void)
+{
+    return current_dirs[smp_cpu_id()];
+}
+
+/* ---------------- TLB cost measurement -------------------------------- */
+
+static uint32_t touch_bench_pages(void)
+{
+    uint32_t sum = 0;
+    for (uint32_t p = 0; p < TLB_BENCH_PAGES; p++)
+    {
+        sum += *(volatile uint32_t *)(TLB_BENCH_VA + p * PAGE_SIZE);
+    }
+    return sum;
+}
+
+/* Unmap and free the first 'mapped' scratch pages and their page table */
+static void release_bench_pages(uint32_t mapped)
+{
+    for (uint32_t p = 0; p < mapped; p++)
+    {
+        frame_free(paging_unmap(kernel_dir, TLB_BENCH_VA + p * PAGE_SIZE));
+    }
+    uint32_t pde = kernel_dir[PDE_INDEX(TLB_BENCH_VA)];
+    if (pde & PTE_PRESENT)
+    {
+        kernel_dir[PDE_INDEX(TLB_BENCH_VA)] = 0;
+        frame_free(pde & PTE_FRAME);
+    }
+    write_cr3((uint32_t)kernel_dir);
+}
+
+static void print_cycles(const char *label, uint32_t total, uint32_t ops)
+{
+    serial_puts(label);
+    serial_put_dec(total / ops);
+    serial_puts(" cycles\n");
+}
+
+void paging_measure_tlb(void)
+{
+    uint32_t *saved = paging_current();
+    paging_switch(kernel_dir);
+
+    /* Scratch 4 KB pages: the only non-global entries, so they get flushed */
+    for (uint32_t p = 0; p < TLB_BENCH_PAGES; p++)
+    {
+        uint32_t frame = frame_alloc();
+        if (frame == 0 || paging_map(kernel_dir, TLB_BENCH_VA + p * PAGE_SIZE, frame, PTE_WRITE) != 0)
+        {
+            /* Touching an unmapped scratch page would fault in ring 0 */
+            frame_free(frame);
+            release_bench_pages(p);
+            paging_switch(saved);
+            serial_puts("TLB benchmark: out of frames\n");
+            return;
+        }
+    }
+
+    uint32_t reload = 0, flush_invlpg = 0, warm = 0, cold = 0;
+
+    for (int r = 0; r < TLB_BENCH_ROUNDS; r++)
+    {
+        uint64_t t0 = rdtsc();
+        write_cr3((uint32_t)kernel_dir);
+        uint64_t t1 = rdtsc();
+        reload += (uint32_t)(t1 - t0);
+
+        /* First touch after the reload walks the page tables */
+        t0 = rdtsc();
+        touch_bench_pages();
+        t1 = rdtsc();
+        cold += (uint32_t)(t1 - t0);
+
+        t0 = rdtsc();
+        touch_bench_pages();
+        t1 = rdtsc();
+        warm += (uint32_t)(t1 - t0);
+
+        t0 = rdtsc();
+        for (uint32_t p = 0; p < TLB_BENCH_PAGES; p++)
+        {
+            invlpg(TLB_BENCH_VA + p * PAGE_SIZE);
+        }
+        t1 = rdtsc();
+        flush_invlpg += (uint32_t)(t1 - t0);
+    }
+
+    serial_puts("TLB cost (average over ");
+    serial_put_dec(TLB_BENCH_ROUNDS);
+    serial_puts(" rounds):\n");
+    print_cycles("  CR3 reload (full non-global flush): ", reload, TLB_BENCH_ROUNDS);
+    print_cycles("  INVLPG, per page:                   ", flush_invlpg, TLB_BENCH_ROUNDS * TLB_BENCH_PAGES);
+    print_cycles("  Access, TLB hit, per page:          ", warm, TLB_BENCH_ROUNDS * TLB_BENCH_PAGES);
+    print_cycles("  Access after flush, per page:       ", cold, TLB_BENCH_ROUNDS * TLB_BENCH_PAGES);
+
+    release_bench_pages(TLB_BENCH_PAGES);
+    paging_switch(saved);
+}
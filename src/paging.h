@@ -0,0 +1,129 @@
+/* paging.h - Physical frames, page tables and address spaces */
+#ifndef KACCHI_PAGING_H
+#define KACCHI_PAGING_H
+
+#include "types.h"
+
+#define PAGE_SIZE 4096u
+#define LARGE_PAGE_SIZE (4u << 20)
+
+/* Page directory / table entry bits */
+#define PTE_PRESENT 0x001u
+#define PTE_WRITE 0x002u
+#define PTE_USER 0x004u
+#define PTE_PWT 0x008u    /* write-through */
+#define PTE_PCD 0x010u    /* cache disable, for device registers */
+#define PTE_LARGE 0x080u  /* PDE maps a 4 MB page (needs CR4.PSE) */
+#define PTE_GLOBAL 0x100u /* survives CR3 reloads (needs CR4.PGE) */
+#define PTE_COW 0x200u    /* software bit: read-only share, copy on write */
+#define PTE_FRAME 0xFFFFF000u
+
+/* Page-fault error code bits */
+#define PF_PRESENT 0x1u /* 0: page not present, 1: protection violation */
+#define PF_WRITE 0x2u
+#define PF_USER 0x4u
+
+/*
+ * Identity map shared by every address space, all global pages: the
+ * first 4 MB (kernel image at 1 MB) in 4 KB pages with per-section
+ * user access, the frame pool above 4 MB in supervisor-only 4 MB pages.
+ */
+#define PAGING_IDENTITY_BYTES (32u << 20)
+#define FRAME_POOL_START (4u << 20)
+#define FRAME_POOL_END PAGING_IDENTITY_BYTES
+
+/*
+ * Per-process stack region: every address space places its stack
+ * just below PROC_STACK_TOP. The region is one page table's worth,
+ * and anything below the mapped stack is an unmapped guard.
+ */
+#define PROC_STACK_TOP 0xC0000000u
+#define PROC_STACK_REGION LARGE_PAGE_SIZE
+
+/*
+ * Per-process kernel stack, supervisor-only, right below the user
+ * stack region with an unmapped guard under it. It sits at the same
+ * address in every space, so TSS.esp0 and the SYSENTER stack are set
+ * once and never touched on a process switch.
+ */
+#define PROC_KSTACK_TOP (PROC_STACK_TOP - PROC_STACK_REGION)
+#define PROC_KSTACK_SIZE (2 * PAGE_SIZE)
+
+/*
+ * Zeroed 4 KB frame (identity mapped, so the address is usable as is)
+ * holding one reference; 0 if none left. Frames shared copy-on-write
+ * take extra references with frame_ref(); frame_free() drops one and
+ * recycles the frame with the last.
+ */
+uint32_t frame_alloc(void);
+void frame_ref(uint32_t phys);
+void frame_free(uint32_t phys);
+uint32_t frame_free_count(void);
+
+/*
+ * Take the pool frames overlapping [start, end) out of circulation for
+ * good, e.g. boot modules the loader put there. They keep a reference
+ * count of 0, so mapping them into any number of spaces and freeing
+ * those spaces never recycles them. Call before the first frame_alloc().
+ */
+void frame_reserve(uint32_t start, uint32_t end);
+
+/*
+ * Build the kernel directory, enable PSE/PGE and turn paging on.
+ * Installs the page-fault handler and the double-fault task.
+ */
+void paging_init(void);
+
+uint32_t *paging_kernel_dir(void);
+
+/* New page directory sharing the kernel mappings; NULL when out of frames. */
+uint32_t *paging_create_space(void);
+
+/*
+ * Copy-on-write clone of 'parent': private page tables are duplicated,
+ * writable user pages become read-only + PTE_COW in both directories
+ * and their frames gain a reference; supervisor pages are copied.
+ * NULL when out of frames.
+ */
+uint32_t *paging_clone_space(uint32_t *parent);
+
+/*
+ * Resolve a write fault on a PTE_COW page: take the frame over if this
+ * is the last reference, otherwise copy it. -1 if 'va' is not COW.
+ */
+int paging_resolve_cow(uint32_t *dir, uint32_t va);
+
+/* Free a directory, its private page tables and every frame they map. */
+void paging_destroy_space(uint32_t *dir);
+
+/* Map one 4 KB page; allocates the page table on demand. 0 on success. */
+int paging_map(uint32_t *dir, uint32_t va, uint32_t pa, uint32_t flags);
+
+/*
+ * Identity-map [pa, pa + len) in the kernel directory with 'flags' for
+ * firmware tables and device registers above the shared identity map.
+ * Only address spaces created afterwards see it, so call during boot.
+ */
+int paging_map_identity(uint32_t pa, uint32_t len, uint32_t flags);
+
+/* Remove a 4 KB mapping and return the frame it pointed to (0 if none). */
+uint32_t paging_unmap(uint32_t *dir, uint32_t va);
+
+/* Physical address backing 'va' in 'dir', or 0 when unmapped. */
+uint32_t paging_lookup(uint32_t *dir, uint32_t va);
+
+/* Load 'dir' into CR3 (no-op when already active). */
+void paging_switch(uint32_t *dir);
+uint32_t *paging_current(void);
+
+/*
+ * Non-zero if ring 3 may access [va, va + len) in 'dir' right now
+ * ('write' also demands write access; copy-on-write counts). Used to
+ * check pointers handed to system calls.
+ */
+int paging_user_ok(uint32_t *dir, uint32_t va, uint32_t len, int write);
+
+/* Print the cycle cost of CR3 reloads, INVLPG and TLB refills. */
+void paging_measure_tlb(void);
+
+#endif /* KACCHI_PAGING_H */
@@ -1,114 +1,458 @@
 #include "process.h"
+#include "chan.h"
+#include "cpu.h"
+#include "elf.h"
+#include "fpu.h"
+#include "gdt.h"
 #include "memory.h"
+#include "paging.h"
+#include "ramfs.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "spinlock.h"
+#include "string.h"
+#include "sync.h"
+#include "trace.h"
 #include "types.h"
+#include "waitset.h"
 
-/* process table */
+/* Ring 3 runs with interrupts on, so the timer tick can sample it */
+#define USER_EFLAGS 0x202u
+
+/* process table: scheduling fields in proc_hot[], the rest in proctab[] */
+proc_hot_t proc_hot[MAX_PROCS] __attribute__((aligned(64)));
 static pcb_t proctab[MAX_PROCS];
 
+/* Slot allocation, state changes and mailboxes across CPUs */
+static spinlock_t proctab_lock = SPINLOCK_INIT;
+
+/* Ring-3 entry and exit trampolines (switch.S) */
+extern void proc_user_start(void);
+extern void proc_user_exit(void);
+
 static int valid_pid(int32_t pid)
 {
     return (pid >= 0 && pid < MAX_PROCS);
 }
 
-static int32_t find_free_pid(void)
+static void reset_accounting(pcb_t *pcb)
 {
+    pcb->created_tsc = rdtsc();
+    pcb->state_tsc = pcb->created_tsc;
+    pcb->run_tsc = 0;
+    pcb->ready_tsc = 0;
+    pcb->blocked_tsc = 0;
+    pcb->switches_voluntary = 0;
+    pcb->switches_involuntary = 0;
+    pcb->rt_period_us = 0; /* every new process starts best-effort */
+    pcb->rt_misses = 0;
+    pcb->rt_overruns = 0;
+    pcb->rt_throttled = 0;
+}
+
+/* Time since the last state change goes to the state being left (caller holds proctab_lock) */
+static void charge_state(pcb_t *pcb, pr_state_t state, uint64_t now)
+{
+    uint64_t spent = now - pcb->state_tsc;
+
+    if (state == PR_RUNNING)
+        pcb->run_tsc += spent;
+    else if (state == PR_READY)
+        pcb->ready_tsc += spent;
+    else if (state == PR_BLOCKED || state == PR_SLEEPING)
+        pcb->blocked_tsc += spent;
+    pcb->state_tsc = now;
+}
+
+/* Reserve a free slot as PR_NEW so no other CPU can take it */
+static int32_t claim_free_pid(void)
+{
+    spin_lock(&proctab_lock);
     for (int32_t i = 0; i < MAX_PROCS; i++)
     {
-        if (proctab[i].state == PR_TERMINATED)
+        if (proc_hot[i].state == PR_TERMINATED)
         {
+            proc_hot[i].state = PR_NEW;
+            reset_accounting(&proctab[i]);
+            spin_unlock(&proctab_lock);
             return i;
         }
     }
+    spin_unlock(&proctab_lock);
     return -1;
 }
 
+static void release_pid(int32_t pid)
+{
+    spin_lock(&proctab_lock);
+    proc_hot[pid].state = PR_TERMINATED;
+    spin_unlock(&proctab_lock);
+}
+
 void proc_init(void)
 {
     for (int i = 0; i < MAX_PROCS; i++)
     {
+        proc_hot[i].state = PR_TERMINATED;
+        proc_hot[i].rq_next = -1;
+        proc_hot[i].rq_cpu = -1;
+        proc_hot[i].on_cpu = 0;
         proctab[i].pid = i;
-        proctab[i].state = PR_TERMINATED;
         proctab[i].entry = NULL;
+        proctab[i].page_dir = NULL;
         proctab[i].stack_base = NULL;
         proctab[i].esp = NULL;
         proctab[i].stack_size = 0;
         proctab[i].has_msg = 0;
+        proctab[i].critical = 0;
+        uheap_init(&proctab[i].uheap);
+        proctab[i].fpu_state = NULL;
+        proctab[i].fpu_cpu = -1;
+        proctab[i].wait_queue = NULL;
+        proctab[i].wq_next = -1;
     }
 }
+/*
+ * Back [from, to) of a stack region with fresh frames, pre-filled with
+ * the high-water pattern. Works on any directory, not just the current.
+ */
+static int commit_stack_pages(uint32_t *dir, uint32_t from, uint32_t to, uint32_t flags)
+{
+    for (uint32_t va = from; va < to; va += PAGE_SIZE)
+    {
+        uint32_t frame = frame_alloc();
+        if (frame == 0 || paging_map(dir, va, frame, flags) != 0)
+        {
+            frame_free(frame);
+            return -1;
+        }
+
+        /* Untouched words keep the pattern, which is how we measure depth */
+        memset((void *)frame, PROC_STACK_FILL & 0xFF, PAGE_SIZE);
+    }
+    return 0;
+}
+
 /* process creation */
-int32_t proc_create(void (*func)(void))
+
+/* Rounded user stack limit, 0 if it leaves no guard page */
+static uint32_t user_stack_size(uint32_t stack_size)
+{
+    if (stack_size == 0)
+        stack_size = PROC_STACK_SIZE;
+    stack_size = (stack_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    /* Keep at least the lowest page of the region unmapped as a guard */
+    return stack_size < PROC_STACK_REGION ? stack_size : 0;
+}
+
+/* Ring-3 process entering 'func' in 'dir', which it takes over (destroyed on failure) */
+static int32_t create_user(uint32_t *dir, void (*func)(void), uint32_t stack_size)
+{
+    int32_t pid = claim_free_pid();
+    if (pid < 0)
+    {
+        paging_destroy_space(dir);
+        return -1;
+    }
+
+    /*
+     * Commit just the top page of the user stack; the rest arrives
+     * through page faults. The kernel stack is committed whole.
+     */
+    uint32_t base = PROC_STACK_TOP - PAGE_SIZE;
+    if (commit_stack_pages(dir, base, PROC_STACK_TOP, PTE_USER | PTE_WRITE) != 0 ||
+        commit_stack_pages(dir, PROC_KSTACK_TOP - PROC_KSTACK_SIZE, PROC_KSTACK_TOP, PTE_WRITE) != 0)
+    {
+        paging_destroy_space(dir);
+        release_pid(pid);
+        return -1;
+    }
+
+    /*
+     * Neither stack is mapped here, so both are written through the
+     * identity-mapped physical address of their top frame.
+     *
+     * User stack: 'func' returns into proc_user_exit, which makes the
+     * exit system call. The zeros above keep the ABI alignment.
+     */
+    uint32_t *usp = (uint32_t *)(paging_lookup(dir, PROC_STACK_TOP - 4) + 4);
+    *--usp = 0;
+    *--usp = 0;
+    *--usp = 0;
+    *--usp = 0;
+    *--usp = (uint32_t)proc_user_exit; /* return address of 'func' */
+
+    /*
+     * Kernel stack: an initial ctxsw frame (see switch.S) whose return
+     * lands in proc_user_start, above it the iret frame that drops to
+     * ring 3 at 'func'.
+     */
+    uint32_t *sp = (uint32_t *)(paging_lookup(dir, PROC_KSTACK_TOP - 4) + 4);
+    *--sp = USER_DS;                        /* ss */
+    *--sp = PROC_STACK_TOP - 5 * 4;         /* esp */
+    *--sp = USER_EFLAGS;                    /* eflags */
+    *--sp = USER_CS;                        /* cs */
+    *--sp = (uint32_t)func;                 /* eip */
+    *--sp = (uint32_t)proc_user_start;      /* ctxsw returns here */
+    *--sp = 0;                              /* ebp */
+    *--sp = 0;                              /* ebx */
+    *--sp = 0;                              /* esi */
+    *--sp = 0;                              /* edi */
+
+    proctab[pid].entry = func;
+    proctab[pid].page_dir = dir;
+    proctab[pid].stack_base = (void *)base;
+    proctab[pid].esp = (uint32_t *)(PROC_KSTACK_TOP - 10 * sizeof(uint32_t));
+    proctab[pid].stack_size = stack_size;
+    proctab[pid].has_msg = 0;
+    uheap_init(&proctab[pid].uheap);
+    proctab[pid].age = 0;
+
+    trace_event(TRACE_CREATE, pid, (uint32_t)scheduler_current_pid());
+    return pid;
+}
+
+int32_t proc_create(void (*func)(void), uint32_t stack_size)
+{
+    stack_size = user_stack_size(stack_size);
+    if (func == NULL || stack_size == 0)
+        return -1;
+
+    uint32_t *dir = paging_create_space();
+    if (dir == NULL)
+        return -1;
+    return create_user(dir, func, stack_size);
+}
+
+int32_t proc_exec(const char *name, uint32_t stack_size)
+{
+    uint32_t size;
+    const void *image = ramfs_mmap(ramfs_open(name), &size);
+    stack_size = user_stack_size(stack_size);
+    if (image == NULL || stack_size == 0)
+        return -1;
+
+    uint32_t *dir = paging_create_space();
+    if (dir == NULL)
+        return -1;
+
+    uint32_t entry;
+    if (elf_load(dir, image, size, &entry) != 0)
+    {
+        paging_destroy_space(dir);
+        return -1;
+    }
+    return create_user(dir, (void (*)(void))entry, stack_size);
+}
+
+/* Where a kernel process's entry function returns to */
+static void proc_kernel_exit(void)
+{
+    scheduler_exit();
+}
+
+int32_t proc_create_kernel(void (*func)(void))
 {
     if (func == NULL)
         return -1;
 
-    int32_t pid = find_free_pid();
+    int32_t pid = claim_free_pid();
     if (pid < 0)
         return -1;
 
-    void *stack = heap_alloc(PROC_STACK_SIZE);
-    if (stack == NULL)
+    /* Its own (otherwise empty) space, so the scheduler treats it like any process */
+    uint32_t *dir = paging_create_space();
+    if (dir == NULL)
+    {
+        release_pid(pid);
+        return -1;
+    }
+    if (commit_stack_pages(dir, PROC_KSTACK_TOP - PROC_KSTACK_SIZE, PROC_KSTACK_TOP, PTE_WRITE) != 0)
+    {
+        paging_destroy_space(dir);
+        release_pid(pid);
         return -1;
+    }
 
-    uint32_t *sp = (uint32_t *)((uintptr_t)stack + PROC_STACK_SIZE);
-    sp = (uint32_t *)((uintptr_t)sp & ~0xFUL);
+    /* Kernel stack: a ctxsw frame returning straight into 'func', which returns into the exit path */
+    uint32_t *sp = (uint32_t *)(paging_lookup(dir, PROC_KSTACK_TOP - 4) + 4);
+    *--sp = 0;
+    *--sp = (uint32_t)proc_kernel_exit; /* return address of 'func' */
+    *--sp = (uint32_t)func;             /* ctxsw returns here */
+    *--sp = 0;                          /* ebp */
+    *--sp = 0;                          /* ebx */
+    *--sp = 0;                          /* esi */
+    *--sp = 0;                          /* edi */
 
     proctab[pid].entry = func;
-    proctab[pid].stack_base = stack;
-    proctab[pid].esp = sp;
-    proctab[pid].stack_size = PROC_STACK_SIZE;
+    proctab[pid].page_dir = dir;
+    proctab[pid].stack_base = (void *)PROC_STACK_TOP; /* no user stack */
+    proctab[pid].esp = (uint32_t *)(PROC_KSTACK_TOP - 7 * sizeof(uint32_t));
+    proctab[pid].stack_size = 0;
     proctab[pid].has_msg = 0;
+    uheap_init(&proctab[pid].uheap);
+    proctab[pid].age = 0;
 
-    proctab[pid].state = PR_NEW;
+    trace_event(TRACE_CREATE, pid, (uint32_t)scheduler_current_pid());
+    return pid;
+}
+
+/*
+ * Second half of proc_fork() (switch.S): 'frame' is the ctxsw frame the
+ * parent just pushed on its kernel stack, which becomes the child's
+ * saved context. The clone copies that stack as it is now, and the
+ * user pages are copy-on-write, so nothing at or above the frame
+ * changes for the child whatever the parent does next.
+ */
+int32_t proc_fork_frame(uint32_t *frame)
+{
+    int32_t parent = scheduler_current_pid();
+    if (parent < 0)
+        return -1;
+
+    int32_t pid = claim_free_pid();
+    if (pid < 0)
+        return -1;
+
+    uint32_t *dir = paging_clone_space(proctab[parent].page_dir);
+    if (dir == NULL)
+    {
+        release_pid(pid);
+        return -1;
+    }
+
+    if (fpu_fork(parent, pid) != 0)
+    {
+        paging_destroy_space(dir);
+        release_pid(pid);
+        return -1;
+    }
+
+    proctab[pid].entry = proctab[parent].entry;
+    proctab[pid].page_dir = dir;
+    proctab[pid].stack_base = proctab[parent].stack_base;
+    proctab[pid].esp = frame;
+    proctab[pid].stack_size = proctab[parent].stack_size;
+    proctab[pid].has_msg = 0;
+    proctab[pid].age = 0;
+    proctab[pid].uheap = proctab[parent].uheap; /* its pages were cloned with the rest */
+
+    trace_event(TRACE_CREATE, pid, (uint32_t)parent);
+    proc_set_state(pid, PR_READY);
 
     return pid;
 }
 
-/* state transition */
-int proc_set_state(int32_t pid, pr_state_t new_state)
+/* State transition; with 'wake_only', only out of PR_BLOCKED or PR_SLEEPING */
+static int change_state(int32_t pid, pr_state_t new_state, int wake_only)
 {
     if (!valid_pid(pid))
         return -1;
-    if (proctab[pid].state == PR_TERMINATED)
+    if (new_state == PR_TERMINATED)
         return -1;
 
-    if (new_state == PR_TERMINATED)
+    spin_lock(&proctab_lock);
+    pr_state_t old_state = proc_hot[pid].state;
+    if (old_state == PR_TERMINATED ||
+        (wake_only && old_state != PR_BLOCKED && old_state != PR_SLEEPING))
+    {
+        spin_unlock(&proctab_lock);
         return -1;
+    }
+    charge_state(&proctab[pid], old_state, rdtsc());
+    /* Nothing preempts: leaving the CPU is always the process's own call */
+    if (old_state == PR_RUNNING && new_state != PR_RUNNING)
+        proctab[pid].switches_voluntary++;
+    proc_hot[pid].state = new_state;
+    spin_unlock(&proctab_lock);
+
+    if ((old_state == PR_BLOCKED || old_state == PR_SLEEPING) && new_state == PR_READY)
+        trace_event(TRACE_WAKE, pid, (uint32_t)scheduler_current_pid());
+
+    /* A yielding process is requeued by the scheduler once it is off the CPU */
+    if (new_state == PR_READY && old_state != PR_READY && old_state != PR_RUNNING)
+        scheduler_enqueue(pid);
 
-    proctab[pid].state = new_state;
     return 0;
 }
 
+int proc_set_state(int32_t pid, pr_state_t new_state)
+{
+    return change_state(pid, new_state, 0);
+}
+
+int proc_wake(int32_t pid)
+{
+    return change_state(pid, PR_READY, 1);
+}
+
 /* process termination */
 int proc_terminate(int32_t pid)
 {
     if (!valid_pid(pid))
         return -1;
 
-    if (proctab[pid].state == PR_TERMINATED)
+    if (proc_hot[pid].state == PR_TERMINATED)
     {
         return 0; /* already terminated */
     }
+    if (proctab[pid].critical)
+        return -1;
 
-    if (proctab[pid].stack_base != NULL)
+    sync_cancel_wait(pid);
+    scheduler_dequeue(pid);
+    scheduler_edf_release(pid);
+    trace_event(TRACE_EXIT, pid, 0);
+
+    if (proctab[pid].page_dir != NULL)
     {
-        heap_free(proctab[pid].stack_base);
+        /* Never free the directory the CPU is still walking */
+        if (paging_current() == proctab[pid].page_dir)
+            paging_switch(paging_kernel_dir());
+        paging_destroy_space(proctab[pid].page_dir);
     }
 
+    fpu_release(pid);
+    waitset_release(pid);
+    chan_release_owner(pid);
+
+    /* Reclaim anything else the process allocated and never freed */
+    heap_release_owner(pid);
+
+    spin_lock(&proctab_lock);
     proctab[pid].entry = NULL;
+    proctab[pid].page_dir = NULL;
     proctab[pid].stack_base = NULL;
     proctab[pid].esp = NULL;
     proctab[pid].stack_size = 0;
     proctab[pid].has_msg = 0;
-    proctab[pid].state = PR_TERMINATED;
+    proc_hot[pid].state = PR_TERMINATED;
+    spin_unlock(&proctab_lock);
 
     return 0;
 }
 
+void proc_count_forced_switch(int32_t pid)
+{
+    if (!valid_pid(pid))
+        return;
+    spin_lock(&proctab_lock);
+    proctab[pid].switches_involuntary++;
+    spin_unlock(&proctab_lock);
+}
+
+void proc_set_critical(int32_t pid)
+{
+    if (valid_pid(pid))
+        proctab[pid].critical = 1;
+}
+
 pcb_t *proc_get_pcb(int32_t pid)
 {
     if (!valid_pid(pid))
         return NULL;
-    if (proctab[pid].state == PR_TERMINATED)
+    if (proc_hot[pid].state == PR_TERMINATED)
         return NULL;
     return &proctab[pid];
 }
@@ -117,22 +461,204 @@ pr_state_t proc_get_state(int32_t pid)
 {
     if (!valid_pid(pid))
         return PR_TERMINATED;
-    return proctab[pid].state;
+    return proc_hot[pid].state;
 }
 
 int32_t proc_is_alive(int32_t pid)
 {
     if (!valid_pid(pid))
         return 0;
-    return (proctab[pid].state != PR_TERMINATED);
+    return (proc_hot[pid].state != PR_TERMINATED);
+}
+
+void *proc_heap_alloc(size_t size)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return NULL;
+
+    return uheap_alloc(&proctab[pid].uheap, proctab[pid].page_dir, size);
+}
+
+int proc_heap_free(void *ptr)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return -1;
+
+    return uheap_free(&proctab[pid].uheap, ptr);
+}
+
+void *proc_alloc(size_t size)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return NULL;
+
+    return uheap_arena_alloc(&proctab[pid].uheap, proctab[pid].page_dir, size);
+}
+
+int proc_get_times(int32_t pid, proc_times_t *out)
+{
+    if (!valid_pid(pid))
+        return -1;
+
+    spin_lock(&proctab_lock);
+    pcb_t *pcb = &proctab[pid];
+    pr_state_t state = proc_hot[pid].state;
+    if (state == PR_TERMINATED)
+    {
+        spin_unlock(&proctab_lock);
+        return -1;
+    }
+
+    /* The interval in the current state is not charged until it ends */
+    uint64_t spent = rdtsc() - pcb->state_tsc;
+
+    out->created_tsc = pcb->created_tsc;
+    out->run_tsc = pcb->run_tsc + (state == PR_RUNNING ? spent : 0);
+    out->ready_tsc = pcb->ready_tsc + (state == PR_READY ? spent : 0);
+    out->blocked_tsc = pcb->blocked_tsc + ((state == PR_BLOCKED || state == PR_SLEEPING) ? spent : 0);
+    out->switches_voluntary = pcb->switches_voluntary;
+    out->switches_involuntary = pcb->switches_involuntary;
+    spin_unlock(&proctab_lock);
+    return 0;
+}
+
+uint32_t proc_stack_committed(int32_t pid)
+{
+    if (!valid_pid(pid) || proctab[pid].page_dir == NULL)
+        return 0;
+    return PROC_STACK_TOP - (uint32_t)proctab[pid].stack_base;
+}
+
+uint32_t proc_heap_bytes(int32_t pid)
+{
+    if (!proc_is_alive(pid))
+        return 0;
+    return uheap_live_bytes(&proctab[pid].uheap);
+}
+
+uint32_t proc_stack_high_water(int32_t pid)
+{
+    if (!valid_pid(pid) || proctab[pid].page_dir == NULL)
+        return 0;
+
+    /* The stack grows down, so untouched words sit at the low end */
+    uint32_t va = (uint32_t)proctab[pid].stack_base;
+    uint32_t untouched = 0;
+
+    while (va < PROC_STACK_TOP)
+    {
+        const uint32_t *word = (const uint32_t *)paging_lookup(proctab[pid].page_dir, va);
+        uint32_t i = 0;
+        while (i < PAGE_SIZE / 4 && word[i] == PROC_STACK_FILL)
+            i++;
+
+        untouched += i * 4;
+        if (i < PAGE_SIZE / 4)
+            break;
+        va += PAGE_SIZE;
+    }
+
+    return proc_stack_committed(pid) - untouched;
+}
+
+/*
+ * Commit the stack from the page holding 'addr' up to what is already
+ * committed, if 'addr' lies in the uncommitted part below the limit.
+ * 1 if it did, 0 if 'addr' is not there, -1 when out of frames.
+ */
+static int grow_stack(pcb_t *pcb, uint32_t addr)
+{
+    uint32_t limit = PROC_STACK_TOP - pcb->stack_size;
+    uint32_t committed = (uint32_t)pcb->stack_base;
+    if (addr < limit || addr >= committed)
+        return 0;
+
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    if (commit_stack_pages(pcb->page_dir, page, committed, PTE_USER | PTE_WRITE) != 0)
+        return -1;
+    pcb->stack_base = (void *)page;
+    return 1;
+}
+
+int proc_user_ok(uint32_t va, uint32_t len, int write)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return 0;
+
+    /* A buffer on a stack page not touched yet: commit it as a fault would */
+    if (len > 0)
+        grow_stack(&proctab[pid], va);
+    return paging_user_ok(proctab[pid].page_dir, va, len, write);
+}
+
+int proc_handle_fault(uint32_t addr, uint32_t error, isr_frame_t *frame)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return -1;
+
+    pcb_t *pcb = &proctab[pid];
+    uint32_t region = PROC_STACK_TOP - PROC_STACK_REGION;
+    uint32_t limit = PROC_STACK_TOP - pcb->stack_size;
+
+    /* Write to a page shared with a fork relative */
+    if ((error & (PF_PRESENT | PF_WRITE)) == (PF_PRESENT | PF_WRITE) &&
+        paging_resolve_cow(pcb->page_dir, addr) == 0)
+    {
+        return 0;
+    }
+
+    /* Stack growth: commit everything from the touched page upward */
+    int grown = !(error & PF_PRESENT) ? grow_stack(pcb, addr) : 0;
+    if (grown > 0)
+    {
+        return 0; /* the faulting instruction restarts */
+    }
+    if (grown < 0)
+    {
+        serial_puts("\n[Fault] PID ");
+        serial_put_dec((uint32_t)pid);
+        serial_puts(": out of frames growing the stack");
+    }
+    else if (!(error & PF_USER))
+    {
+        return -1; /* kernel code faulted: a bug, not the process's doing */
+    }
+    else
+    {
+        serial_puts("\n[Fault] PID ");
+        serial_put_dec((uint32_t)pid);
+        if (!(error & PF_PRESENT) && addr >= region && addr < limit)
+            serial_puts(": stack overflow past its limit");
+        else
+            serial_puts(": page fault");
+    }
+    serial_puts(" at ");
+    serial_put_hex(addr);
+    serial_puts(", EIP ");
+    serial_put_hex(frame->eip);
+    serial_puts(" - terminating\n");
+
+    /* We are on the process's own kernel stack: exit right from here */
+    scheduler_exit();
+    return 0;
 }
 
 int proc_send(int32_t dst_pid, const char *msg)
 {
     if (!valid_pid(dst_pid))
         return -1;
-    if (proctab[dst_pid].state == PR_TERMINATED)
+
+    spin_lock(&proctab_lock);
+    if (proc_hot[dst_pid].state == PR_TERMINATED)
+    {
+        spin_unlock(&proctab_lock);
         return -1;
+    }
 
     int i = 0;
     while (msg[i] && i < IPC_MSG_SIZE - 1)
@@ -142,7 +668,10 @@ int proc_send(int32_t dst_pid, const char *msg)
     }
     proctab[dst_pid].msg[i] = '\0';
     proctab[dst_pid].has_msg = 1;
+    spin_unlock(&proctab_lock);
 
+    trace_event(TRACE_SEND, scheduler_current_pid(), (uint32_t)dst_pid);
+    waitset_notify(WS_MAILBOX, dst_pid);
     return 0;
 }
 
@@ -150,18 +679,29 @@ int proc_recv(int32_t pid, char *out)
 {
     if (!valid_pid(pid))
         return -1;
+
+    /* Copy out under the lock; 'out' may take a copy-on-write fault */
+    char msg[IPC_MSG_SIZE];
+    spin_lock(&proctab_lock);
     if (!proctab[pid].has_msg)
+    {
+        spin_unlock(&proctab_lock);
+        trace_event(TRACE_RECV, pid, 0);
         return -1;
+    }
+    memcpy(msg, proctab[pid].msg, IPC_MSG_SIZE);
+    proctab[pid].has_msg = 0;
+    spin_unlock(&proctab_lock);
+    trace_event(TRACE_RECV, pid, 1);
 
     int i = 0;
     while (i < IPC_MSG_SIZE)
     {
-        out[i] = proctab[pid].msg[i];
+        out[i] = msg[i];
         if (out[i] == '\0')
             break;
         i++;
     }
 
-    proctab[pid].has_msg = 0;
     return 0;
 }
\ No newline at end of file
@@ -2,10 +2,13 @@
 #define PROCESS_H
 
 #include "types.h"
+#include "uheap.h"
+#include "idt.h"
 
 /* Process Manager Config */
-#define MAX_PROCS 16
-#define PROC_STACK_SIZE 512 /* Reduced from 4096 to allow more processes */
+#define MAX_PROCS 64
+#define PROC_STACK_SIZE 16384 /* default stack limit; only touched pages are committed */
+#define PROC_STACK_FILL 0xA5A5A5A5u /* pre-filled pattern for high-water marks */
 #define IPC_MSG_SIZE 32
 
 /* process states */
@@ -19,35 +22,181 @@ typedef enum
     PR_SLEEPING
 } pr_state_t;
 
-/*process control block */
+/*
+ * Scheduling half of a process: what run-queue walks, dispatch and
+ * state scans read, packed two to a cache line in proc_hot[] so they
+ * never pull in the rest of the PCB. Indexed by PID like the PCBs.
+ */
 typedef struct
 {
-    int32_t pid;
     pr_state_t state;
+    int32_t rq_next;             /* next PID in its run queue, -1 at the tail */
+    int32_t rq_cpu;              /* CPU whose run queue holds it, -1 if none */
+    volatile int on_cpu;         /* a CPU is still running on its kernel stack */
+    uint64_t wake_ns;            /* PR_SLEEPING until clock_ns() reaches this */
+    uint64_t rt_abs_deadline_ns; /* EDF: deadline of the current job (queue order) */
+} __attribute__((aligned(32))) proc_hot_t;
+
+extern proc_hot_t proc_hot[MAX_PROCS];
+
+/*process control block: everything else, touched once a process is picked */
+typedef struct
+{
+    int32_t pid;
     void (*entry)(void);
 
-    void *stack_base;
-    uint32_t *esp;
-    uint32_t stack_size;
+    uint32_t *page_dir; /* private address space (stack regions) */
+    void *stack_base;   /* lowest committed user stack address, virtual */
+    uint32_t *esp;      /* saved kernel-stack pointer while switched out */
+    uint32_t stack_size; /* reserved limit; pages below stack_base commit on first touch */
     char msg[IPC_MSG_SIZE];
     int has_msg;
     uint32_t age; /* For process aging (bonus feature) */
+    int critical; /* kernel service: proc_terminate() refuses it */
+    uheap_t uheap; /* heap and arena in its own space, dropped wholesale on exit */
+
+    /* PR_BLOCKED on a wait queue (sync.c) */
+    void *wait_queue;     /* wait_queue_t it is linked on, NULL if none */
+    int32_t wq_next;      /* next PID on that queue, -1 at the tail */
+    uint32_t *wait_space; /* futex key: address space (NULL: shared) ... */
+    uint32_t wait_addr;   /* ... and address */
+
+    /* EDF class (scheduler.c); rt_period_us == 0 for best-effort round-robin */
+    uint32_t rt_runtime_us;
+    uint32_t rt_period_us;
+    uint32_t rt_deadline_us;     /* relative to each release */
+    uint32_t rt_misses;          /* jobs finished past their deadline */
+    uint32_t rt_overruns;        /* jobs that ran longer than rt_runtime_us */
+    int rt_throttled;            /* over budget: best-effort until the next release */
+    uint64_t rt_release_ns;      /* start of the current period */
+    uint64_t rt_job_run_tsc;     /* run_tsc when the current job was released */
+
+    void *fpu_state; /* FXSAVE area, allocated on first FPU use (fpu.c) */
+    int32_t fpu_cpu; /* CPU whose registers may still hold that state, -1 if none */
+
+    /* CPU accounting in TSC cycles, charged on every state change */
+    uint64_t created_tsc;
+    uint64_t state_tsc;   /* when the current state was entered */
+    uint64_t run_tsc;     /* RUNNING */
+    uint64_t ready_tsc;   /* READY: runnable, waiting for a CPU */
+    uint64_t blocked_tsc; /* BLOCKED or SLEEPING */
+    uint32_t switches_voluntary;   /* gave up the CPU: yield, block or sleep */
+    uint32_t switches_involuntary; /* demoted by the scheduler (EDF budget overrun) */
 } pcb_t;
 
 void proc_init(void);
-int32_t proc_create(void (*func)(void));
+/*
+ * New ring-3 process entering 'func'; returning from it exits. Its code
+ * reaches the kernel only through system calls (usys.h). stack_size is
+ * the user stack limit (0 selects PROC_STACK_SIZE), rounded up to whole
+ * pages. Only the top page is committed up front.
+ */
+int32_t proc_create(void (*func)(void), uint32_t stack_size);
+
+/*
+ * New ring-3 process running the ELF32 executable 'name' from the ramfs,
+ * like proc_create() otherwise. Its text and constants map the module's
+ * own frames, shared by every instance; only writable data and the
+ * stacks cost frames per process. -1 if the file is missing or invalid.
+ */
+int32_t proc_exec(const char *name, uint32_t stack_size);
 
-/* state transition */
+/*
+ * New process running 'func' in ring 0 on its kernel stack, for kernel
+ * workers. It has no user stack and leaves the CPU only through the
+ * scheduler calls; returning from 'func' exits.
+ */
+int32_t proc_create_kernel(void (*func)(void));
+
+/*
+ * Unix-style fork for the running process: the child gets a copy of the
+ * PCB and shares the parent's pages copy-on-write. Returns the child's
+ * PID in the parent, 0 in the child (once scheduled), -1 on failure.
+ * The child starts with a copy of the heap and an empty mailbox. (switch.S)
+ */
+int32_t proc_fork(void);
+
+/*
+ * State transition. Becoming READY from NEW or BLOCKED puts the process
+ * on the calling CPU's run queue.
+ */
 int proc_set_state(int32_t pid, pr_state_t new_state);
 
-/* terminate + cleanup */
+/*
+ * PR_BLOCKED or PR_SLEEPING -> PR_READY; -1 and no change from any
+ * other state. For wakers that may race with another wake-up.
+ */
+int proc_wake(int32_t pid);
+
+/* terminate + cleanup; -1 for a critical process, which must never exit */
 int proc_terminate(int32_t pid);
 
+/* Protect a kernel service (e.g. the work-queue worker) from proc_terminate() */
+void proc_set_critical(int32_t pid);
+
+/*
+ * Count a switch the process did not ask for. Scheduling is
+ * cooperative, so the only one is losing EDF priority on an overrun.
+ */
+void proc_count_forced_switch(int32_t pid);
+
 /* NULL if invalid/terminated */
 pcb_t *proc_get_pcb(int32_t pid);
 pr_state_t proc_get_state(int32_t pid);
 int32_t proc_is_alive(int32_t pid);
 
+/* Accounting snapshot; the current state's time counts up to now */
+typedef struct
+{
+    uint64_t created_tsc;
+    uint64_t run_tsc;
+    uint64_t ready_tsc;
+    uint64_t blocked_tsc;
+    uint32_t switches_voluntary;
+    uint32_t switches_involuntary;
+} proc_times_t;
+
+/* -1 if the PID is not in use */
+int proc_get_times(int32_t pid, proc_times_t *out);
+
+/* Deepest stack use seen so far, in bytes (scan for the fill pattern) */
+uint32_t proc_stack_high_water(int32_t pid);
+
+/* Bytes of stack currently backed by frames */
+uint32_t proc_stack_committed(int32_t pid);
+
+/* Bytes in live blocks of the process's own heap, arena chunks included */
+uint32_t proc_heap_bytes(int32_t pid);
+
+/*
+ * Heap blocks for the running process, in its own address space (see
+ * uheap.h); NULL / -1 outside a process or when nothing fits.
+ */
+void *proc_heap_alloc(size_t size);
+int proc_heap_free(void *ptr);
+
+/* Bump-allocate from the running process's arena; NULL outside a process.
+ * Memory lives until the process terminates. */
+void *proc_alloc(size_t size);
+
+/*
+ * Page-fault policy, called from the #PF handler on the faulting
+ * process's kernel stack. Copy-on-write faults are resolved and a touch
+ * below the committed stack but within its limit commits the missing
+ * pages; any other ring-3 fault (e.g. the guard below the limit)
+ * terminates just that process and does not return. Returns 0 if the
+ * fault was handled, -1 if it is a kernel bug.
+ */
+int proc_handle_fault(uint32_t addr, uint32_t error, isr_frame_t *frame);
+
+/*
+ * paging_user_ok() for the running process, system-call pointer checks:
+ * a range starting on its stack below the committed part but within
+ * the limit is committed first, the same rule proc_handle_fault()
+ * applies to a touch, so a buffer on a fresh stack page passes.
+ */
+int proc_user_ok(uint32_t va, uint32_t len, int write);
+
 int proc_send(int32_t dst_pid, const char *msg);
 int proc_recv(int32_t pid, char *out);
 
@@ -0,0 +1,71 @@
+/* prof.c - Sampling profiler fed by the timer interrupt */
+#include "prof.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "smp.h"
+#include "timer.h"
+
+/* Preallocated so the timer interrupt never allocates */
+static prof_sample_t samples[PROF_MAX_SAMPLES];
+
+/* Slots claimed so far; may run past PROF_MAX_SAMPLES (those are dropped) */
+static volatile uint32_t claimed = 0;
+static volatile int active = 0;
+
+void prof_start(void)
+{
+    prof_stop();
+    claimed = 0;
+    __atomic_store_n(&active, 1, __ATOMIC_RELEASE);
+
+    /* Arm the sampling timer here and on every other CPU */
+    timer_reprogram();
+    smp_kick_all();
+}
+
+void prof_stop(void)
+{
+    __atomic_store_n(&active, 0, __ATOMIC_RELEASE);
+}
+
+int prof_active(void)
+{
+    return active;
+}
+
+uint32_t prof_sample_count(void)
+{
+    return claimed < PROF_MAX_SAMPLES ? claimed : PROF_MAX_SAMPLES;
+}
+
+uint32_t prof_dropped(void)
+{
+    return claimed - prof_sample_count();
+}
+
+void prof_sample(const isr_frame_t *frame)
+{
+    if (!__atomic_load_n(&active, __ATOMIC_ACQUIRE))
+        return;
+
+    /* One atomic add per sample: CPUs never share a slot */
+    uint32_t slot = __atomic_fetch_add(&claimed, 1, __ATOMIC_RELAXED);
+    if (slot >= PROF_MAX_SAMPLES)
+        return;
+
+    samples[slot].eip = frame->eip;
+    samples[slot].pid = (int16_t)scheduler_current_pid();
+    samples[slot].cpu = (uint8_t)smp_cpu_id();
+    samples[slot].flags = (frame->cs & 3) ? PROF_USER : 0;
+}
+
+size_t prof_write_samples(void)
+{
+    uint32_t count = prof_sample_count();
+    uint32_t header[4] = {PROF_MAGIC, count, prof_dropped(), PROF_HZ};
+
+    serial_write(header, sizeof(header));
+    serial_write(samples, (size_t)count * sizeof(prof_sample_t));
+
+    return sizeof(header) + (size_t)count * sizeof(prof_sample_t);
+}
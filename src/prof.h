@@ -0,0 +1,50 @@
+/* prof.h - Sampling profiler fed by the timer interrupt */
+#ifndef KACCHI_PROF_H
+#define KACCHI_PROF_H
+
+#include "types.h"
+#include "idt.h"
+
+#define PROF_MAX_SAMPLES 32768
+#define PROF_HZ 1000 /* samples per second per CPU */
+#define PROF_MAGIC 0x464F5250u /* "PROF" */
+
+/* Sample flags */
+#define PROF_USER 0x01 /* interrupted code was running in ring 3 */
+
+/* One sample: where the CPU was and on whose behalf */
+typedef struct
+{
+    uint32_t eip;
+    int16_t pid; /* -1 outside any process (shell, scheduler loop) */
+    uint8_t cpu;
+    uint8_t flags;
+} prof_sample_t;
+
+/*
+ * Clear the buffer and sample every CPU PROF_HZ times a second from now
+ * on (the timer is only armed that often while profiling).
+ */
+void prof_start(void);
+void prof_stop(void);
+
+/* Profiling is on */
+int prof_active(void);
+
+/* Samples recorded, and samples lost because the buffer was full */
+uint32_t prof_sample_count(void);
+uint32_t prof_dropped(void);
+
+/* Timer interrupt hook; takes no locks (any CPU, any context) */
+void prof_sample(const isr_frame_t *frame);
+
+/*
+ * Stream the samples over serial for tools/profsym.py as a compact
+ * little-endian record:
+ *   u32 magic, u32 count, u32 dropped, u32 hz,
+ *   then per sample: u32 eip, i16 pid, u8 cpu, u8 flags.
+ * Returns the number of bytes written.
+ */
+size_t prof_write_samples(void);
+
+#endif /* KACCHI_PROF_H */
@@ -0,0 +1,206 @@
+/* ramfs.c - Read-only files backed by boot modules */
+#include "ramfs.h"
+#include "paging.h"
+#include "serial.h"
+#include "string.h"
+
+#define RAMFS_BUCKETS 64 /* power of two */
+
+typedef struct
+{
+    char name[RAMFS_NAME_MAX];
+    const uint8_t *data; /* physical = kernel virtual */
+    uint32_t size;
+    uint32_t user_va;    /* window address, 0 if the window is full */
+    int32_t hash_next;   /* next file in the same bucket, -1 at the end */
+} ramfs_file_t;
+
+static ramfs_file_t files[RAMFS_MAX_FILES];
+static int file_count = 0;
+static int32_t buckets[RAMFS_BUCKETS];
+
+/* FNV-1a */
+static uint32_t name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int valid_fd(int fd)
+{
+    return fd >= 0 && fd < file_count;
+}
+
+/* Last path component of the first word of 'cmdline', truncated to fit */
+static void module_name(char *out, const char *cmdline, int index)
+{
+    const char *base = cmdline;
+    const char *p = cmdline;
+    while (*p && *p != ' ')
+    {
+        if (*p == '/')
+            base = p + 1;
+        p++;
+    }
+
+    int len = 0;
+    while (base + len < p && len < RAMFS_NAME_MAX - 1)
+    {
+        out[len] = base[len];
+        len++;
+    }
+    if (len == 0)
+    {
+        strcpy(out, "module");
+        len = 6;
+        out[len++] = '0' + index / 10;
+        out[len++] = '0' + index % 10;
+    }
+    out[len] = '\0';
+}
+
+void ramfs_init(const multiboot_info_t *mbi)
+{
+    for (int b = 0; b < RAMFS_BUCKETS; b++)
+        buckets[b] = -1;
+    file_count = 0;
+
+    if (mbi == NULL || !(mbi->flags & MULTIBOOT_INFO_MODS))
+        return;
+
+    const multiboot_module_t *mods = (const multiboot_module_t *)mbi->mods_addr;
+    uint32_t window = RAMFS_MAP_BASE;
+
+    for (uint32_t m = 0; m < mbi->mods_count; m++)
+    {
+        const multiboot_module_t *mod = &mods[m];
+        if (file_count == RAMFS_MAX_FILES)
+        {
+            serial_puts("[RAMFS] Too many modules, ignoring the rest\n");
+            break;
+        }
+        if (mod->mod_end < mod->mod_start)
+            continue;
+
+        ramfs_file_t *f = &files[file_count];
+        if (mod->string != 0 && mod->string < PAGING_IDENTITY_BYTES)
+            module_name(f->name, (const char *)mod->string, (int)m);
+        else
+            module_name(f->name, "", (int)m);
+
+        if (ramfs_open(f->name) >= 0)
+        {
+            serial_puts("[RAMFS] Duplicate name ");
+            serial_puts(f->name);
+            serial_puts(", skipped\n");
+            continue;
+        }
+
+        /* Before anything can hand these frames out or map over them */
+        uint32_t size = mod->mod_end - mod->mod_start;
+        frame_reserve(mod->mod_start, mod->mod_end);
+        if (paging_map_identity(mod->mod_start, size, 0) != 0)
+        {
+            serial_puts("[RAMFS] Cannot map ");
+            serial_puts(f->name);
+            serial_puts(", skipped\n");
+            continue;
+        }
+
+        f->data = (const uint8_t *)mod->mod_start;
+        f->size = size;
+
+        /* Same sub-page offset as the data, so whole pages map 1:1 */
+        uint32_t span = ((mod->mod_start & ~PTE_FRAME) + size + PAGE_SIZE - 1) & PTE_FRAME;
+        f->user_va = 0;
+        if (span <= RAMFS_MAP_END - window)
+        {
+            f->user_va = window + (mod->mod_start & ~PTE_FRAME);
+            window += span;
+        }
+
+        uint32_t bucket = name_hash(f->name) & (RAMFS_BUCKETS - 1);
+        f->hash_next = buckets[bucket];
+        buckets[bucket] = file_count;
+        file_count++;
+    }
+
+    serial_puts("[RAMFS] ");
+    serial_put_dec((uint32_t)file_count);
+    serial_puts(" file(s) from boot modules\n");
+}
+
+int ramfs_open(const char *name)
+{
+    if (name == NULL)
+        return -1;
+
+    for (int32_t fd = buckets[name_hash(name) & (RAMFS_BUCKETS - 1)]; fd >= 0; fd = files[fd].hash_next)
+    {
+        if (string_equal(files[fd].name, name))
+            return fd;
+    }
+    return -1;
+}
+
+int ramfs_count(void)
+{
+    return file_count;
+}
+
+const char *ramfs_name(int fd)
+{
+    return valid_fd(fd) ? files[fd].name : NULL;
+}
+
+uint32_t ramfs_size(int fd)
+{
+    return valid_fd(fd) ? files[fd].size : 0;
+}
+
+uint32_t ramfs_read(int fd, uint32_t offset, uint32_t len, const void **data)
+{
+    if (!valid_fd(fd) || offset >= files[fd].size)
+        return 0;
+
+    uint32_t left = files[fd].size - offset;
+    *data = files[fd].data + offset;
+    return len < left ? len : left;
+}
+
+const void *ramfs_mmap(int fd, uint32_t *size)
+{
+    if (!valid_fd(fd))
+        return NULL;
+    *size = files[fd].size;
+    return files[fd].data;
+}
+
+uint32_t ramfs_map_user(int fd)
+{
+    if (!valid_fd(fd) || files[fd].user_va == 0)
+        return 0;
+
+    ramfs_file_t *f = &files[fd];
+    uint32_t *dir = paging_current();
+    if (dir == paging_kernel_dir())
+        return 0; /* not from a process */
+    uint32_t pa = (uint32_t)f->data & PTE_FRAME;
+    uint32_t va = f->user_va & PTE_FRAME;
+    uint32_t end = (uint32_t)f->data + f->size;
+
+    /* Read-only and never PTE_COW: a write is a fault, not a copy */
+    for (; pa < end; pa += PAGE_SIZE, va += PAGE_SIZE)
+    {
+        if (paging_lookup(dir, va) == pa)
+            continue;
+        if (paging_map(dir, va, pa, PTE_USER) != 0)
+            return 0;
+    }
+    return f->user_va;
+}
@@ -0,0 +1,55 @@
+/* ramfs.h - Read-only files backed by boot modules */
+#ifndef KACCHI_RAMFS_H
+#define KACCHI_RAMFS_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define RAMFS_MAX_FILES 32
+#define RAMFS_NAME_MAX 32 /* including the NUL */
+
+/*
+ * User window: each file has one fixed, page-aligned address in it,
+ * the same in every address space, where ramfs_map_user() shows it.
+ */
+#define RAMFS_MAP_BASE 0x40000000u
+#define RAMFS_MAP_END 0x80000000u
+
+/*
+ * Every Multiboot module becomes a file named after the last path
+ * component of its command line, in one flat directory with a hashed
+ * name index. The data stays where the loader put it: nothing is
+ * copied, reads hand out pointers into it, and its frames are kept out
+ * of the frame pool. A descriptor is simply the file's index.
+ */
+
+/* Index the modules of 'mbi' (may be NULL); call after paging_init(), before any frame_alloc() */
+void ramfs_init(const multiboot_info_t *mbi);
+
+/* Descriptor for 'name', -1 if there is no such file */
+int ramfs_open(const char *name);
+
+/* Files present; descriptors are 0 .. ramfs_count() - 1 */
+int ramfs_count(void);
+
+/* NULL / 0 for a bad descriptor */
+const char *ramfs_name(int fd);
+uint32_t ramfs_size(int fd);
+
+/*
+ * Zero-copy read: point '*data' at byte 'offset' of the file and return
+ * how many of the 'len' requested bytes are there (0 at or past the end).
+ */
+uint32_t ramfs_read(int fd, uint32_t offset, uint32_t len, const void **data);
+
+/* The whole file in the kernel's view (identity mapped), size in '*size'; NULL if bad */
+const void *ramfs_mmap(int fd, uint32_t *size);
+
+/*
+ * Map the file read-only into the running process at its window
+ * address and return that address (0 if it has none or frames ran
+ * out). Mapping it again is harmless; it goes away with the process.
+ */
+uint32_t ramfs_map_user(int fd);
+
+#endif /* KACCHI_RAMFS_H */
@@ -1,84 +1,875 @@
 #include "scheduler.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "paging.h"
 #include "process.h"
 #include "serial.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "trace.h"
+#include "workq.h"
 
-/* Currently running process ID */
-static int32_t current_pid = -1;
+#define SCHED_BENCH_ROUNDS 1000
+
+/* Why a process last handed its CPU back to the scheduler loop */
+typedef enum
+{
+    SWITCH_YIELD, /* still READY: requeue it */
+    SWITCH_EXIT,  /* finished: reap it */
+    SWITCH_BLOCK  /* waiting: whoever wakes it queues it again */
+} switch_reason_t;
+
+/* FIFO of READY processes, linked through proc_hot_t.rq_next */
+typedef struct
+{
+    spinlock_t lock;
+    int32_t head;
+    int32_t tail;
+    volatile uint32_t length;
+} run_queue_t;
+
+/* Per-CPU scheduler state */
+typedef struct
+{
+    int32_t current_pid;     /* process on this CPU, -1 in the scheduler loop */
+    uint32_t *sched_esp;     /* scheduler loop context while a process runs */
+    switch_reason_t reason;  /* set by the process just before it switches back */
+    run_queue_t rq;
+    uint32_t dispatches;
+    uint32_t steals;         /* processes taken from another CPU's queue */
+    volatile int idle;       /* halted (or about to): enqueuers must kick it */
+} sched_cpu_t;
+
+static sched_cpu_t sched_cpus[MAX_CPUS] = {
+    [0 ... MAX_CPUS - 1] = {.current_pid = -1, .rq = {SPINLOCK_INIT, -1, -1, 0}},
+};
+
+/* rq_cpu of a process on the EDF queue */
+#define EDF_QUEUE MAX_CPUS
+
+/* READY EDF processes, earliest absolute deadline first, shared by all CPUs */
+static run_queue_t edf_queue = {SPINLOCK_INIT, -1, -1, 0};
+
+/* Admitted EDF density in parts per million (under edf_queue.lock) */
+static uint32_t edf_load_ppm = 0;
+
+/* Processes that are READY or RUNNING anywhere; 0 means all work is done */
+static volatile uint32_t sched_active;
+
+/* Set while scheduler_run() is in progress; APs only schedule then */
+static volatile int sched_running;
+
+static void (*sched_monitor)(void) = NULL;
+
+/* Guards PR_SLEEPING transitions and next_wake_ns */
+static spinlock_t sleep_lock = SPINLOCK_INIT;
+
+/* Earliest wake_ns of any sleeper, 0 if none; read without the lock as a hint */
+static volatile uint64_t next_wake_ns = 0;
+
+/* ---------------------------------------------------
+ * Run queues (caller holds rq->lock)
+ * --------------------------------------------------- */
+static void rq_push(run_queue_t *rq, int cpu, int32_t pid)
+{
+    proc_hot_t *hot = &proc_hot[pid];
+
+    hot->rq_next = -1;
+    hot->rq_cpu = cpu;
+    if (rq->tail >= 0)
+        proc_hot[rq->tail].rq_next = pid;
+    else
+        rq->head = pid;
+    rq->tail = pid;
+    rq->length++;
+}
+
+static int32_t rq_pop(run_queue_t *rq)
+{
+    int32_t pid = rq->head;
+    if (pid < 0)
+        return -1;
+
+    proc_hot_t *hot = &proc_hot[pid];
+    rq->head = hot->rq_next;
+    if (rq->head < 0)
+        rq->tail = -1;
+    rq->length--;
+    hot->rq_next = -1;
+    hot->rq_cpu = -1;
+    return pid;
+}
+
+static int rq_remove(run_queue_t *rq, int32_t pid)
+{
+    int32_t prev = -1;
+    for (int32_t at = rq->head; at >= 0; prev = at, at = proc_hot[at].rq_next)
+    {
+        if (at != pid)
+            continue;
+
+        proc_hot_t *hot = &proc_hot[pid];
+        if (prev >= 0)
+            proc_hot[prev].rq_next = hot->rq_next;
+        else
+            rq->head = hot->rq_next;
+        if (rq->tail == pid)
+            rq->tail = prev;
+        rq->length--;
+        hot->rq_next = -1;
+        hot->rq_cpu = -1;
+        return 1;
+    }
+    return 0;
+}
+
+/* Sorted insert by absolute deadline; FIFO among equal deadlines (caller holds the lock) */
+static void edf_insert(int32_t pid)
+{
+    proc_hot_t *hot = &proc_hot[pid];
+    int32_t prev = -1;
+    int32_t at = edf_queue.head;
+
+    while (at >= 0 && proc_hot[at].rt_abs_deadline_ns <= hot->rt_abs_deadline_ns)
+    {
+        prev = at;
+        at = proc_hot[at].rq_next;
+    }
+
+    hot->rq_next = at;
+    hot->rq_cpu = EDF_QUEUE;
+    if (prev >= 0)
+        proc_hot[prev].rq_next = pid;
+    else
+        edf_queue.head = pid;
+    if (at < 0)
+        edf_queue.tail = pid;
+    edf_queue.length++;
+}
+
+/*
+ * Scheduling is cooperative, so a budget can only be checked when the
+ * process hands the CPU back; an overrunning job finishes as
+ * best-effort work and gets its priority back at the next release.
+ */
+static int edf_throttled(int32_t pid, pcb_t *pcb)
+{
+    if (!pcb->rt_throttled &&
+        timer_tsc_to_ns(pcb->run_tsc - pcb->rt_job_run_tsc) > (uint64_t)pcb->rt_runtime_us * 1000)
+    {
+        pcb->rt_throttled = 1;
+        pcb->rt_overruns++;
+        proc_count_forced_switch(pid);
+    }
+    return pcb->rt_throttled;
+}
+
+static void enqueue_on(int cpu, int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (pcb->rt_period_us != 0 && !edf_throttled(pid, pcb))
+    {
+        spin_lock(&edf_queue.lock);
+        edf_insert(pid);
+        spin_unlock(&edf_queue.lock);
+        return;
+    }
+
+    run_queue_t *rq = &sched_cpus[cpu].rq;
+    spin_lock(&rq->lock);
+    rq_push(rq, cpu, pid);
+    spin_unlock(&rq->lock);
+}
 
 /* ---------------------------------------------------
  * Initialize scheduler
  * --------------------------------------------------- */
 void scheduler_init(void)
 {
-    current_pid = -1;
+    /* Run queues keep whatever is already READY */
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+        sched_cpus[cpu].current_pid = -1;
+}
+
+/* Wake halted CPUs so they look at the queues again */
+static void kick_idle_cpus(void)
+{
+    /* Pairs with the barrier in idle(): either we see its flag or it sees our work */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (sched_cpus[cpu].idle)
+            smp_kick(cpu);
+    }
+}
+
+/* One fewer READY/RUNNING process; the last one lets scheduler_run() return */
+static void active_done(void)
+{
+    if (__atomic_sub_fetch(&sched_active, 1, __ATOMIC_SEQ_CST) == 0)
+        kick_idle_cpus();
+}
+
+void scheduler_enqueue(int32_t pid)
+{
+    /* Count it first so no CPU can finish it and see the total drop below zero */
+    __atomic_add_fetch(&sched_active, 1, __ATOMIC_SEQ_CST);
+    enqueue_on(smp_cpu_id(), pid);
+    if (sched_running)
+        kick_idle_cpus();
+}
+
+void scheduler_dequeue(int32_t pid)
+{
+    if (pid < 0 || pid >= MAX_PROCS || proc_hot[pid].rq_cpu < 0)
+        return;
+
+    int32_t at = proc_hot[pid].rq_cpu;
+    run_queue_t *rq = at == EDF_QUEUE ? &edf_queue : &sched_cpus[at].rq;
+    spin_lock(&rq->lock);
+    int removed = rq_remove(rq, pid);
+    spin_unlock(&rq->lock);
+
+    if (removed)
+        active_done();
 }
 
 /* ---------------------------------------------------
- * Find next READY process (Round Robin)
+ * Find next READY process: the earliest EDF deadline if any, then the
+ * own queue (FIFO, i.e. Round Robin), otherwise steal the oldest entry
+ * of the longest other queue
  * --------------------------------------------------- */
-static int32_t find_next_ready(void)
+static int32_t find_next_ready(int cpu)
 {
-    int32_t start = current_pid;
+    sched_cpu_t *self = &sched_cpus[cpu];
+    int32_t pid;
 
-    for (int i = 0; i < MAX_PROCS; i++)
+    if (edf_queue.length > 0)
     {
-        start = (start + 1) % MAX_PROCS;
+        spin_lock(&edf_queue.lock);
+        pid = rq_pop(&edf_queue);
+        spin_unlock(&edf_queue.lock);
+        if (pid >= 0)
+            return pid;
+    }
+
+    spin_lock(&self->rq.lock);
+    pid = rq_pop(&self->rq);
+    spin_unlock(&self->rq.lock);
+    if (pid >= 0)
+        return pid;
 
-        if (proc_get_state(start) == PR_READY)
+    int victim = -1;
+    uint32_t longest = 0;
+    for (int other = 0; other < MAX_CPUS; other++)
+    {
+        /* Unlocked peek: only a hint, the pop below decides */
+        if (other != cpu && smp_cpu_online(other) && sched_cpus[other].rq.length > longest)
         {
-            return start;
+            victim = other;
+            longest = sched_cpus[other].rq.length;
         }
     }
-    return -1;
+    if (victim < 0)
+        return -1;
+
+    run_queue_t *rq = &sched_cpus[victim].rq;
+    spin_lock(&rq->lock);
+    pid = rq_pop(rq);
+    spin_unlock(&rq->lock);
+
+    if (pid >= 0)
+        self->steals++;
+    return pid;
+}
+
+/* ---------------------------------------------------
+ * Run one process on this CPU until it yields, blocks or exits
+ * --------------------------------------------------- */
+static void dispatch(int cpu, int32_t pid)
+{
+    sched_cpu_t *self = &sched_cpus[cpu];
+    proc_hot_t *hot = &proc_hot[pid];
+    pcb_t *pcb = proc_get_pcb(pid);
+
+    /* Woken before it finished switching out elsewhere: let it get off */
+    while (__atomic_load_n(&hot->on_cpu, __ATOMIC_ACQUIRE))
+        cpu_relax();
+
+    hot->on_cpu = 1;
+    self->current_pid = pid;
+    self->dispatches++;
+    proc_set_state(pid, PR_RUNNING);
+
+    trace_event(TRACE_DISPATCH, pid, 0);
+
+    /* Switch to the process; we resume here when it yields, blocks or exits */
+    paging_switch(pcb->page_dir);
+    fpu_switch_in(pid);
+    ctxsw(&self->sched_esp, pcb->esp);
+    fpu_switch_out(pid);
+
+    /*
+     * Never keep a directory loaded once its process is off the CPU:
+     * another CPU may change its tables or free it.
+     */
+    paging_switch(paging_kernel_dir());
+    self->current_pid = -1;
+    switch_reason_t reason = self->reason;
+
+    if (reason == SWITCH_EXIT)
+    {
+        proc_terminate(pid);
+
+        serial_puts("[Scheduler] Process PID ");
+        serial_put_dec((uint32_t)pid);
+        serial_puts(" terminated\n");
+    }
+
+    /* Its saved context is complete: other CPUs may run it from here on */
+    __atomic_store_n(&hot->on_cpu, 0, __ATOMIC_RELEASE);
+
+    if (reason == SWITCH_YIELD)
+        enqueue_on(cpu, pid);
+    else
+        active_done();
+}
+
+/* ---------------------------------------------------
+ * Sleepers: make every process whose wake_ns has passed READY
+ * --------------------------------------------------- */
+static void wake_sleepers(void)
+{
+    uint64_t due = next_wake_ns;
+    if (due == 0 || clock_ns() < due)
+        return;
+
+    spin_lock(&sleep_lock);
+    uint64_t now = clock_ns();
+    uint64_t next = 0;
+    for (int32_t pid = 0; pid < MAX_PROCS; pid++)
+    {
+        proc_hot_t *hot = &proc_hot[pid];
+        if (hot->state != PR_SLEEPING)
+            continue;
+
+        if (hot->wake_ns <= now)
+            proc_wake(pid); /* a wait-set notification may have beaten us to it */
+        else if (next == 0 || hot->wake_ns < next)
+            next = hot->wake_ns;
+    }
+    next_wake_ns = next;
+    spin_unlock(&sleep_lock);
+}
+
+/* Something for this CPU to do (checked with interrupts off before halting) */
+static int work_pending(int cpu)
+{
+    if (!sched_running)
+        return 0;
+
+    uint64_t wake = next_wake_ns;
+    if (wake && clock_ns() >= wake)
+        return 1;
+
+    /* The boot CPU must notice that scheduler_run() can return */
+    if (cpu == 0 && sched_active == 0 && wake == 0)
+        return 1;
+
+    if (edf_queue.length > 0)
+        return 1;
+
+    for (int other = 0; other < MAX_CPUS; other++)
+    {
+        if (smp_cpu_online(other) && sched_cpus[other].rq.length > 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Tickless idle: halt until kicked or until the earliest sleeper is
+ * due. No timer is armed at all when nobody sleeps.
+ */
+static void idle(int cpu)
+{
+    sched_cpu_t *self = &sched_cpus[cpu];
+
+    cpu_irq_disable();
+    __atomic_store_n(&self->idle, 1, __ATOMIC_SEQ_CST);
+    if (!work_pending(cpu))
+        timer_idle(sched_running ? next_wake_ns : 0);
+    __atomic_store_n(&self->idle, 0, __ATOMIC_SEQ_CST);
+    cpu_irq_enable();
 }
 
 /* ---------------------------------------------------
- * Run scheduler loop (cooperative, no context switch)
+ * Run scheduler loop (cooperative, each process on its own stack).
+ * The boot CPU drives it; online APs join in until every queue has
+ * drained and nothing is running.
  * --------------------------------------------------- */
 void scheduler_run(void)
 {
     serial_puts("\n[Scheduler] Starting Round-Robin scheduling\n");
 
+    int cpu = smp_cpu_id();
+    uint64_t second = (uint64_t)timer_tsc_khz() * 1000;
+    uint64_t monitor_due = rdtsc() + second;
+    sched_running = 1;
+    kick_idle_cpus();
+
     while (1)
     {
-        int32_t next = find_next_ready();
+        if (sched_monitor && rdtsc() >= monitor_due)
+        {
+            sched_monitor();
+            monitor_due = rdtsc() + second;
+        }
+
+        /* ctxsw does not carry EFLAGS: a process that left from a fault handler had IF off */
+        cpu_irq_enable();
+        wake_sleepers();
+        workq_poll();
+        int32_t next = find_next_ready(cpu);
 
-        if (next < 0)
+        if (next >= 0)
+        {
+            dispatch(cpu, next);
+            continue;
+        }
+
+        /* Other CPUs may still be running something that yields back, or a sleeper is due later */
+        if (__atomic_load_n(&sched_active, __ATOMIC_SEQ_CST) == 0 && next_wake_ns == 0)
         {
             serial_puts("[Scheduler] No READY process. CPU idle.\n");
             break; /* Exit if no processes */
         }
+        idle(cpu);
+    }
 
-        current_pid = next;
-        proc_set_state(next, PR_RUNNING);
+    sched_running = 0;
+}
 
-        serial_puts("[Scheduler] Running process PID ");
-        serial_putc('0' + (next % 10));
-        serial_puts("\n");
+void scheduler_ap_loop(void)
+{
+    int cpu = smp_cpu_id();
 
-        /* Get PCB and run the process function */
-        pcb_t *pcb = proc_get_pcb(next);
-        if (pcb && pcb->entry)
+    while (1)
+    {
+        cpu_irq_enable();
+        int32_t next = -1;
+        if (sched_running)
         {
-            pcb->entry();
+            wake_sleepers();
+            workq_poll();
+            next = find_next_ready(cpu);
         }
 
-        /* If process returns, terminate it */
-        proc_terminate(next);
+        if (next >= 0)
+            dispatch(cpu, next);
+        else
+            idle(cpu);
+    }
+}
 
-        serial_puts("[Scheduler] Process PID ");
-        serial_putc('0' + (next % 10));
-        serial_puts(" terminated\n");
+/* ---------------------------------------------------
+ * Currently executing process (-1 in shell/kernel context)
+ * --------------------------------------------------- */
+int32_t scheduler_current_pid(void)
+{
+    int32_t pid = sched_cpus[smp_cpu_id()].current_pid;
+    if (pid >= 0 && proc_get_state(pid) == PR_RUNNING)
+    {
+        return pid;
     }
+    return -1;
 }
 
 /* ---------------------------------------------------
- * Cooperative yield (mark current as READY)
+ * Cooperative yield (mark current as READY and switch)
  * --------------------------------------------------- */
 void scheduler_yield(void)
 {
-    if (current_pid >= 0 && proc_is_alive(current_pid))
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
     {
-        proc_set_state(current_pid, PR_READY);
+        return; /* called from the shell, nothing to switch away from */
+    }
+
+    sched_cpu_t *self = &sched_cpus[smp_cpu_id()];
+    trace_event(TRACE_YIELD, pid, 0);
+    proc_set_state(pid, PR_READY);
+    self->reason = SWITCH_YIELD;
+    /* May resume on another CPU: do not touch 'self' afterwards */
+    ctxsw(&proc_get_pcb(pid)->esp, self->sched_esp);
+}
+
+/* ---------------------------------------------------
+ * Block the running process until proc_set_state() makes it READY
+ * --------------------------------------------------- */
+void scheduler_block(void)
+{
+    scheduler_block_unlock(NULL);
+}
+
+void scheduler_block_unlock(spinlock_t *lock)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+    {
+        if (lock)
+            spin_unlock(lock);
+        return;
+    }
+
+    sched_cpu_t *self = &sched_cpus[smp_cpu_id()];
+    trace_event(TRACE_BLOCK, pid, 0);
+    proc_set_state(pid, PR_BLOCKED);
+    if (lock)
+        spin_unlock(lock);
+    self->reason = SWITCH_BLOCK;
+    ctxsw(&proc_get_pcb(pid)->esp, self->sched_esp);
+}
+
+/* ---------------------------------------------------
+ * Sleep until clock_ns() reaches wake_ns
+ * --------------------------------------------------- */
+void scheduler_sleep_until(uint64_t wake_ns)
+{
+    scheduler_sleep_until_unlock(wake_ns, NULL);
+}
+
+void scheduler_sleep_until_unlock(uint64_t wake_ns, spinlock_t *lock)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+    {
+        if (lock)
+            spin_unlock(lock);
+        return;
+    }
+
+    sched_cpu_t *self = &sched_cpus[smp_cpu_id()];
+    pcb_t *pcb = proc_get_pcb(pid);
+
+    /* State and deadline change together, so wake_sleepers() never misses it */
+    spin_lock(&sleep_lock);
+    proc_hot[pid].wake_ns = wake_ns;
+    trace_event(TRACE_SLEEP, pid, 0);
+    proc_set_state(pid, PR_SLEEPING);
+    if (next_wake_ns == 0 || wake_ns < next_wake_ns)
+        next_wake_ns = wake_ns;
+    spin_unlock(&sleep_lock);
+    if (lock)
+        spin_unlock(lock);
+
+    self->reason = SWITCH_BLOCK;
+    ctxsw(&pcb->esp, self->sched_esp);
+}
+
+/* ---------------------------------------------------
+ * EDF class
+ * --------------------------------------------------- */
+
+/* runtime/deadline in parts per million, rounded up so admission stays safe */
+static uint32_t edf_density_ppm(uint32_t runtime_us, uint32_t deadline_us)
+{
+    /* Scale down until runtime * 10^6 fits in 32 bits (runtime <= deadline) */
+    while (deadline_us >= 4096)
+    {
+        deadline_us = (deadline_us + 1) >> 1;
+        runtime_us = (runtime_us + 1) >> 1;
+    }
+    return (runtime_us * 1000000u + deadline_us - 1) / deadline_us;
+}
+
+/* Start a job at 'release' (the calling process is RUNNING, so nothing else writes these) */
+static void edf_release(int32_t pid, pcb_t *pcb, uint64_t release)
+{
+    proc_times_t times;
+    proc_get_times(pid, &times);
+
+    pcb->rt_release_ns = release;
+    proc_hot[pid].rt_abs_deadline_ns = release + (uint64_t)pcb->rt_deadline_us * 1000;
+    pcb->rt_job_run_tsc = times.run_tsc;
+    pcb->rt_throttled = 0;
+}
+
+int scheduler_set_edf(uint32_t runtime_us, uint32_t period_us, uint32_t deadline_us)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return -1;
+
+    pcb_t *pcb = proc_get_pcb(pid);
+    int best_effort = runtime_us == 0 && period_us == 0;
+    if (deadline_us == 0)
+        deadline_us = period_us;
+    if (!best_effort && (runtime_us == 0 || runtime_us > deadline_us || deadline_us > period_us))
+        return -1;
+
+    uint32_t old_ppm = pcb->rt_period_us ? edf_density_ppm(pcb->rt_runtime_us, pcb->rt_deadline_us) : 0;
+    uint32_t new_ppm = best_effort ? 0 : edf_density_ppm(runtime_us, deadline_us);
+
+    spin_lock(&edf_queue.lock);
+    if (edf_load_ppm - old_ppm + new_ppm > EDF_MAX_PPM)
+    {
+        spin_unlock(&edf_queue.lock);
+        return -1;
+    }
+    edf_load_ppm = edf_load_ppm - old_ppm + new_ppm;
+    spin_unlock(&edf_queue.lock);
+
+    pcb->rt_runtime_us = runtime_us;
+    pcb->rt_deadline_us = deadline_us;
+    edf_release(pid, pcb, clock_ns());
+    pcb->rt_period_us = best_effort ? 0 : period_us; /* last: enqueue_on() keys on it */
+    return 0;
+}
+
+int scheduler_edf_wait(void)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return 0;
+
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (pcb->rt_period_us == 0)
+    {
+        scheduler_yield();
+        return 0;
+    }
+
+    uint64_t now = clock_ns();
+    int missed = now > proc_hot[pid].rt_abs_deadline_ns;
+    if (missed)
+        pcb->rt_misses++;
+
+    uint64_t release = pcb->rt_release_ns + (uint64_t)pcb->rt_period_us * 1000;
+    if (release < now)
+        release = now; /* ran past a whole period: restart the phase */
+    edf_release(pid, pcb, release);
+
+    scheduler_sleep_until(release);
+    return missed;
+}
+
+void scheduler_edf_release(int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (pcb == NULL || pcb->rt_period_us == 0)
+        return;
+
+    spin_lock(&edf_queue.lock);
+    edf_load_ppm -= edf_density_ppm(pcb->rt_runtime_us, pcb->rt_deadline_us);
+    spin_unlock(&edf_queue.lock);
+    pcb->rt_period_us = 0;
+}
+
+uint32_t scheduler_edf_load(void)
+{
+    return edf_load_ppm;
+}
+
+/* ---------------------------------------------------
+ * Process exit: back to the scheduler, which reaps it
+ * --------------------------------------------------- */
+void scheduler_exit(void)
+{
+    int32_t pid = scheduler_current_pid();
+    pcb_t *pcb = proc_get_pcb(pid);
+    sched_cpu_t *self = &sched_cpus[smp_cpu_id()];
+
+    self->reason = SWITCH_EXIT;
+    ctxsw(&pcb->esp, self->sched_esp);
+
+    /* Not reached: the scheduler never resumes an exited process */
+    while (1)
+    {
+    }
+}
+
+void scheduler_set_monitor(void (*monitor)(void))
+{
+    sched_monitor = monitor;
+}
+
+/* ---------------------------------------------------
+ * Per-CPU counters for 'info' and the SMP benchmark
+ * --------------------------------------------------- */
+void scheduler_print_cpu_stats(void)
+{
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (!smp_cpu_online(cpu))
+            continue;
+
+        serial_puts("  CPU ");
+        serial_put_dec((uint32_t)cpu);
+        serial_puts(": ");
+        serial_put_dec(sched_cpus[cpu].dispatches);
+        serial_puts(" dispatches, ");
+        serial_put_dec(sched_cpus[cpu].steals);
+        serial_puts(" stolen, ");
+        serial_put_dec(sched_cpus[cpu].rq.length);
+        serial_puts(" queued\n");
+    }
+}
+
+/* ---------------------------------------------------
+ * Layout benchmark
+ * --------------------------------------------------- */
+
+/* Stand-in for the table before the split: one scanned word per whole pcb_t */
+static pcb_t stride_bench[MAX_PROCS];
+
+static uint32_t cache_line = 0; /* CLFLUSH granule, 0 if unsupported */
+
+/* Evict [p, p + bytes) so the next touch comes from memory */
+static void evict(const void *p, uint32_t bytes)
+{
+    if (cache_line == 0)
+        return;
+    for (uint32_t off = 0; off < bytes; off += cache_line)
+        clflush((const uint8_t *)p + off);
+    uint32_t a, b, c, d;
+    cpuid(0, &a, &b, &c, &d); /* serializing: the flushes are done */
+}
+
+/* Cache lines (64 bytes) a scan reading one word per 'stride' bytes pulls in */
+static uint32_t lines_touched(int n, uint32_t stride)
+{
+    return stride >= 64 ? (uint32_t)n : ((uint32_t)n * stride + 63) / 64;
+}
+
+static uint32_t scan_hot(int n)
+{
+    uint32_t ready = 0;
+    for (int i = 0; i < n; i++)
+        ready += ((volatile proc_hot_t *)&proc_hot[i])->state == PR_READY;
+    return ready;
+}
+
+static uint32_t scan_stride(int n)
+{
+    uint32_t ready = 0;
+    for (int i = 0; i < n; i++)
+        ready += ((volatile pcb_t *)&stride_bench[i])->has_msg != 0;
+    return ready;
+}
+
+/* Cycles for one call of scan(n) from cold caches (0 without CLFLUSH) and averaged warm */
+static void time_scan(uint32_t (*scan)(int), const void *table, uint32_t bytes, int n,
+                      uint32_t *cold, uint32_t *warm)
+{
+    *cold = 0;
+    if (cache_line)
+    {
+        evict(table, bytes);
+        uint64_t t0 = rdtsc();
+        scan(n);
+        *cold = (uint32_t)(rdtsc() - t0);
+    }
+
+    uint64_t t0 = rdtsc();
+    for (int r = 0; r < SCHED_BENCH_ROUNDS; r++)
+        scan(n);
+    *warm = (uint32_t)(rdtsc() - t0) / SCHED_BENCH_ROUNDS;
+}
+
+/* Private copy of the hot table for the queue timing: live links are never borrowed */
+static proc_hot_t rotate_bench[MAX_PROCS];
+
+/* rq_push()/rq_pop() over rotate_bench, same work per call */
+static void bench_push(run_queue_t *rq, int32_t pid)
+{
+    rotate_bench[pid].rq_next = -1;
+    rotate_bench[pid].rq_cpu = 0;
+    if (rq->tail >= 0)
+        rotate_bench[rq->tail].rq_next = pid;
+    else
+        rq->head = pid;
+    rq->tail = pid;
+    rq->length++;
+}
+
+static int32_t bench_pop(run_queue_t *rq)
+{
+    int32_t pid = rq->head;
+    rq->head = rotate_bench[pid].rq_next;
+    if (rq->head < 0)
+        rq->tail = -1;
+    rq->length--;
+    rotate_bench[pid].rq_next = -1;
+    rotate_bench[pid].rq_cpu = -1;
+    return pid;
+}
+
+/* Round-robin n entries through a scratch queue: the dispatch path's queue work */
+static void time_rotate(int n, uint32_t *cold, uint32_t *warm)
+{
+    run_queue_t rq = {SPINLOCK_INIT, -1, -1, 0};
+    for (int32_t pid = 0; pid < n; pid++)
+        bench_push(&rq, pid);
+
+    *cold = 0;
+    if (cache_line)
+    {
+        evict(rotate_bench, sizeof(rotate_bench));
+        uint64_t t0 = rdtsc();
+        bench_push(&rq, bench_pop(&rq));
+        *cold = (uint32_t)(rdtsc() - t0);
+    }
+
+    uint64_t t0 = rdtsc();
+    for (int r = 0; r < SCHED_BENCH_ROUNDS; r++)
+        bench_push(&rq, bench_pop(&rq));
+    *warm = (uint32_t)(rdtsc() - t0) / SCHED_BENCH_ROUNDS;
+}
+
+static void print_pair(const char *label, uint32_t cold, uint32_t warm)
+{
+    serial_puts(label);
+    if (cache_line)
+        serial_put_dec(cold);
+    else
+        serial_puts("-");
+    serial_puts("/");
+    serial_put_dec(warm);
+}
+
+void scheduler_measure(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    cache_line = (d & CPUID_EDX_CLFSH) ? ((b >> 8) & 0xFF) * 8 : 0;
+
+    serial_puts("Scheduler table cost in cycles, cold/warm (");
+    serial_put_dec(sizeof(proc_hot_t));
+    serial_puts("-byte hot entries, ");
+    serial_put_dec(sizeof(pcb_t));
+    serial_puts("-byte PCBs");
+    if (cache_line == 0)
+        serial_puts(", no CLFLUSH: warm only");
+    serial_puts("):\n");
+
+    for (int n = 8; n <= MAX_PROCS; n *= 2)
+    {
+        uint32_t hot_cold, hot_warm, pcb_cold, pcb_warm, rq_cold, rq_warm;
+        time_scan(scan_hot, proc_hot, sizeof(proc_hot), n, &hot_cold, &hot_warm);
+        time_scan(scan_stride, stride_bench, sizeof(stride_bench), n, &pcb_cold, &pcb_warm);
+        time_rotate(n, &rq_cold, &rq_warm);
+
+        serial_puts("  ");
+        serial_put_dec((uint32_t)n);
+        print_pair(" procs: state scan ", hot_cold, hot_warm);
+        serial_puts(" (");
+        serial_put_dec(lines_touched(n, sizeof(proc_hot_t)));
+        print_pair(" lines), at PCB stride ", pcb_cold, pcb_warm);
+        serial_puts(" (");
+        serial_put_dec(lines_touched(n, sizeof(pcb_t)));
+        print_pair(" lines), pop+push ", rq_cold, rq_warm);
+        serial_puts("\n");
     }
 }
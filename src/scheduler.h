@@ -1,13 +1,96 @@
 #ifndef KACCHI_SCHEDULER_H
 #define KACCHI_SCHEDULER_H
 
+#include "spinlock.h"
+#include "types.h"
+
 /* Initialize scheduler */
 void scheduler_init(void);
 
 /* Pick next process and run it */
 void scheduler_run(void);
 
+/* Run queued processes on an AP whenever scheduler_run() is active. Never returns. */
+void scheduler_ap_loop(void);
+
 /* Yield CPU voluntarily */
 void scheduler_yield(void);
 
+/*
+ * Put the running process to sleep; it resumes after someone sets it
+ * PR_READY again, possibly on another CPU.
+ */
+void scheduler_block(void);
+
+/*
+ * scheduler_block(), releasing 'lock' only once the process is
+ * PR_BLOCKED: a waker that takes the same lock cannot slip in between
+ * the caller's last check and the sleep.
+ */
+void scheduler_block_unlock(spinlock_t *lock);
+
+/* Put the running process to sleep until clock_ns() reaches wake_ns */
+void scheduler_sleep_until(uint64_t wake_ns);
+
+/* The same, releasing 'lock' once the process is PR_SLEEPING */
+void scheduler_sleep_until_unlock(uint64_t wake_ns, spinlock_t *lock);
+
+/*
+ * Move the running process into the EDF class: every period_us it is
+ * released with a budget of runtime_us, due deadline_us after the
+ * release (0: at the end of the period). READY EDF processes always
+ * run before round-robin ones, earliest deadline first. Admission
+ * control keeps the summed density runtime/deadline within
+ * EDF_MAX_PPM; -1 (and no change) if the set would not fit or the
+ * parameters are inconsistent. All zeros goes back to round-robin.
+ */
+#define EDF_MAX_PPM 950000u
+int scheduler_set_edf(uint32_t runtime_us, uint32_t period_us, uint32_t deadline_us);
+
+/*
+ * End the current job and sleep until the next release. Returns 1 if
+ * the job finished past its deadline. Plain yield for best-effort.
+ */
+int scheduler_edf_wait(void);
+
+/* Return a terminating process's bandwidth to the admission budget */
+void scheduler_edf_release(int32_t pid);
+
+/* Admitted EDF bandwidth, parts per million of one CPU */
+uint32_t scheduler_edf_load(void);
+
+/* End the running process; the scheduler frees it. Does not return. */
+void scheduler_exit(void);
+
+/*
+ * Save callee-saved registers on the current stack, store ESP in
+ * *save_esp, then resume the context saved at load_esp (switch.S).
+ */
+void ctxsw(uint32_t **save_esp, uint32_t *load_esp);
+
+/* PID of the process currently executing, or -1 outside any process */
+int32_t scheduler_current_pid(void);
+
+/* Queue a process that just became READY on this CPU's run queue */
+void scheduler_enqueue(int32_t pid);
+
+/* Take a process off whichever run queue holds it (no-op if none) */
+void scheduler_dequeue(int32_t pid);
+
+/*
+ * While scheduler_run() is active, call 'monitor' from the boot CPU's
+ * loop about once a second (NULL to stop). Used by 'top on'.
+ */
+void scheduler_set_monitor(void (*monitor)(void));
+
+/* Dispatch and steal counters of every online CPU */
+void scheduler_print_cpu_stats(void);
+
+/*
+ * Cycles for a state scan and for run-queue pop + push over 8 to
+ * MAX_PROCS table entries, cache-cold and warm, next to the same scan
+ * at whole-PCB stride. Queues are timed on a private copy of the table.
+ */
+void scheduler_measure(void);
+
 #endif
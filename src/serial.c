@@ -1,9 +1,13 @@
 /* serial.c - Serial port driver (COM1) */
 #include "serial.h"
 #include "io.h"
+#include "spinlock.h"
 
 #define COM1 0x3F8   /* I/O port base address for COM1 */
 
+/* One writer at a time, so lines from different CPUs do not interleave */
+static spinlock_t serial_lock = SPINLOCK_INIT;
+
 /*
 You can find more information here: https://caro.su/msx/ocm_de1/16550.pdf
 
@@ -36,18 +40,58 @@ static int is_transmit_empty(void) {
     return inb(COM1 + 5) & 0x20;
 }
 
-void serial_putc(char c) {
+static void emit(char c) {
     if (c == '\n') {
-        serial_putc('\r');  /* Add carriage return */
+        emit('\r');  /* Add carriage return */
     }
     while (!is_transmit_empty());
     outb(COM1, c);
 }
 
+void serial_putc(char c) {
+    spin_lock(&serial_lock);
+    emit(c);
+    spin_unlock(&serial_lock);
+}
+
 void serial_puts(const char* str) {
+    spin_lock(&serial_lock);
     while (*str) {
-        serial_putc(*str++);
+        emit(*str++);
+    }
+    spin_unlock(&serial_lock);
+}
+
+void serial_put_dec(uint32_t value) {
+    char buf[11];
+    int i = 10;
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    serial_puts(&buf[i]);
+}
+
+void serial_put_hex(uint32_t value) {
+    static const char digits[] = "0123456789abcdef";
+    char buf[11] = "0x";
+    for (int i = 0; i < 8; i++) {
+        buf[2 + i] = digits[(value >> (28 - 4 * i)) & 0xF];
+    }
+    buf[10] = '\0';
+    serial_puts(buf);
+}
+
+/* Raw byte stream: no '\n' -> "\r\n" translation, so binary survives */
+void serial_write(const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    spin_lock(&serial_lock);
+    while (len--) {
+        while (!is_transmit_empty());
+        outb(COM1, *p++);
     }
+    spin_unlock(&serial_lock);
 }
 
 static int serial_received(void) {
@@ -9,4 +9,9 @@ void serial_putc(char c);
 void serial_puts(const char* str);
 char serial_getc(void);
 
+/* Numeric output and raw (untranslated) byte streams for host tools */
+void serial_put_dec(uint32_t value);
+void serial_put_hex(uint32_t value);
+void serial_write(const void* buf, size_t len);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,391 @@
+/* smp.c - Processor discovery (ACPI / MP tables) and AP startup */
+#include "smp.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "idt.h"
+#include "lapic.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "spinlock.h"
+#include "string.h"
+#include "syscall.h"
+#include "timer.h"
+
+#define AP_TRAMPOLINE 0x8000u /* must match ap_boot.S */
+#define AP_STACK_SIZE 8192
+#define AP_START_TIMEOUT_US 100000
+
+/* Interrupt command register: delivery modes */
+#define ICR_INIT 0x00000500
+#define ICR_STARTUP 0x00000600
+#define ICR_ASSERT 0x00004000
+
+/* BIOS area searched for the ACPI RSDP and the MP floating pointer */
+#define BIOS_ROM_START 0xE0000u
+#define BIOS_ROM_END 0x100000u
+
+typedef struct __attribute__((packed))
+{
+    char signature[8]; /* "RSD PTR " */
+    uint8_t checksum;
+    char oem[6];
+    uint8_t revision;
+    uint32_t rsdt;
+} acpi_rsdp_t;
+
+typedef struct __attribute__((packed))
+{
+    char signature[4];
+    uint32_t length; /* whole table, header included */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem[6];
+    char oem_table[8];
+    uint32_t oem_revision;
+    uint32_t creator;
+    uint32_t creator_revision;
+} acpi_header_t;
+
+typedef struct __attribute__((packed))
+{
+    acpi_header_t header; /* "APIC" */
+    uint32_t lapic_base;
+    uint32_t flags;
+    /* variable-length entries follow */
+} acpi_madt_t;
+
+typedef struct __attribute__((packed))
+{
+    char signature[4]; /* "_MP_" */
+    uint32_t config;
+    uint8_t length; /* in 16-byte units */
+    uint8_t spec;
+    uint8_t checksum;
+    uint8_t features[5];
+} mp_float_t;
+
+typedef struct __attribute__((packed))
+{
+    char signature[4]; /* "PCMP" */
+    uint16_t length;
+    uint8_t spec;
+    uint8_t checksum;
+    char oem[8];
+    char product[12];
+    uint32_t oem_table;
+    uint16_t oem_size;
+    uint16_t entry_count;
+    uint32_t lapic_base;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+    /* entries follow: processors are 20 bytes, everything else 8 */
+} mp_config_t;
+
+typedef struct
+{
+    uint32_t apic_id;
+    volatile int online;
+} cpu_info_t;
+
+static cpu_info_t cpus[MAX_CPUS];
+static int cpus_online = 1;
+
+/* APIC IDs reported by the firmware, boot CPU included */
+static uint32_t found_ids[MAX_CPUS];
+static int found_count = 0;
+
+static uint8_t ap_stacks[MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+static volatile int ap_starting; /* CPU index the trampoline is bringing up */
+
+/* Trampoline blob and its data slots (ap_boot.S) */
+extern uint8_t ap_trampoline_start[], ap_trampoline_end[];
+extern uint8_t ap_boot_cr0[], ap_boot_cr3[], ap_boot_cr4[], ap_boot_esp[], ap_boot_entry[];
+
+/* Where a trampoline symbol ends up once the blob is copied */
+#define TRAMPOLINE_SLOT(sym) ((uint32_t *)(AP_TRAMPOLINE + ((sym) - ap_trampoline_start)))
+
+/* ---------------- Helpers --------------------------------------------- */
+
+static uint8_t checksum(const void *base, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)base;
+    uint8_t sum = 0;
+    while (len--)
+    {
+        sum += *p++;
+    }
+    return sum;
+}
+
+static int signature_is(const char *sig, const char *want, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (sig[i] != want[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void record_cpu(uint32_t apic_id)
+{
+    if (found_count < MAX_CPUS)
+    {
+        found_ids[found_count++] = apic_id;
+    }
+}
+
+/* ---------------- Firmware tables ------------------------------------- */
+
+static const acpi_header_t *map_acpi_table(uint32_t addr)
+{
+    if (paging_map_identity(addr, sizeof(acpi_header_t), 0) != 0)
+    {
+        return NULL;
+    }
+    const acpi_header_t *table = (const acpi_header_t *)addr;
+    if (paging_map_identity(addr, table->length, 0) != 0 || checksum(table, table->length) != 0)
+    {
+        return NULL;
+    }
+    return table;
+}
+
+/* ACPI: RSDP -> RSDT -> MADT processor-local APIC entries */
+static uint32_t scan_acpi(void)
+{
+    const acpi_rsdp_t *rsdp = NULL;
+    for (uint32_t addr = BIOS_ROM_START; addr < BIOS_ROM_END; addr += 16)
+    {
+        const acpi_rsdp_t *probe = (const acpi_rsdp_t *)addr;
+        if (signature_is(probe->signature, "RSD PTR ", 8) && checksum(probe, sizeof(*probe)) == 0)
+        {
+            rsdp = probe;
+            break;
+        }
+    }
+    if (rsdp == NULL)
+    {
+        return 0;
+    }
+
+    const acpi_header_t *rsdt = map_acpi_table(rsdp->rsdt);
+    if (rsdt == NULL)
+    {
+        return 0;
+    }
+
+    const uint32_t *tables = (const uint32_t *)(rsdt + 1);
+    uint32_t entries = (rsdt->length - sizeof(acpi_header_t)) / 4;
+
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        const acpi_header_t *table = map_acpi_table(tables[i]);
+        if (table == NULL || !signature_is(table->signature, "APIC", 4))
+        {
+            continue;
+        }
+
+        const acpi_madt_t *madt = (const acpi_madt_t *)table;
+        const uint8_t *p = (const uint8_t *)(madt + 1);
+        const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+
+        while (p + 2 <= end && p[1] >= 2)
+        {
+            /* Type 0: processor local APIC {uid, apic_id, flags}; bit 0 = enabled */
+            if (p[0] == 0 && p[1] >= 8 && (*(const uint32_t *)(p + 4) & 1))
+            {
+                record_cpu(p[3]);
+            }
+            p += p[1];
+        }
+        return madt->lapic_base;
+    }
+    return 0;
+}
+
+/* Intel MP specification: floating pointer -> configuration table */
+static uint32_t scan_mp(void)
+{
+    for (uint32_t addr = BIOS_ROM_START; addr < BIOS_ROM_END; addr += 16)
+    {
+        const mp_float_t *mpf = (const mp_float_t *)addr;
+        if (!signature_is(mpf->signature, "_MP_", 4) || checksum(mpf, mpf->length * 16) != 0)
+        {
+            continue;
+        }
+        if (mpf->config == 0 || paging_map_identity(mpf->config, sizeof(mp_config_t), 0) != 0)
+        {
+            return 0; /* default configurations are not supported */
+        }
+
+        const mp_config_t *cfg = (const mp_config_t *)mpf->config;
+        if (!signature_is(cfg->signature, "PCMP", 4) ||
+            paging_map_identity(mpf->config, cfg->length, 0) != 0 ||
+            checksum(cfg, cfg->length) != 0)
+        {
+            return 0;
+        }
+
+        const uint8_t *p = (const uint8_t *)(cfg + 1);
+        for (uint16_t i = 0; i < cfg->entry_count; i++)
+        {
+            if (p[0] == 0)
+            {
+                /* Processor {type, apic_id, version, flags}; bit 0 = enabled */
+                if (p[3] & 1)
+                {
+                    record_cpu(p[1]);
+                }
+                p += 20;
+            }
+            else
+            {
+                p += 8;
+            }
+        }
+        return cfg->lapic_base;
+    }
+    return 0;
+}
+
+/* ---------------- AP startup ------------------------------------------ */
+
+/* First C code on an AP, on its own boot stack with paging already on */
+static void ap_entry(void)
+{
+    int cpu = ap_starting;
+
+    gdt_load(cpu);
+    idt_load();
+    syscall_init_cpu();
+    fpu_init_cpu();
+    lapic_enable();
+    timer_init_cpu();
+
+    __atomic_store_n(&cpus[cpu].online, 1, __ATOMIC_RELEASE);
+    cpu_irq_enable();
+    scheduler_ap_loop();
+}
+
+/* INIT, then two STARTUP IPIs, as in the MP specification */
+static int start_ap(int cpu)
+{
+    memcpy((void *)AP_TRAMPOLINE, ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+    *TRAMPOLINE_SLOT(ap_boot_cr0) = read_cr0();
+    *TRAMPOLINE_SLOT(ap_boot_cr3) = (uint32_t)paging_kernel_dir();
+    *TRAMPOLINE_SLOT(ap_boot_cr4) = read_cr4();
+    *TRAMPOLINE_SLOT(ap_boot_esp) = (uint32_t)(ap_stacks[cpu] + AP_STACK_SIZE);
+    *TRAMPOLINE_SLOT(ap_boot_entry) = (uint32_t)ap_entry;
+    ap_starting = cpu;
+
+    lapic_send_ipi(cpus[cpu].apic_id, ICR_INIT | ICR_ASSERT);
+    pit_delay_us(10000);
+    for (int i = 0; i < 2; i++)
+    {
+        lapic_send_ipi(cpus[cpu].apic_id, ICR_STARTUP | ICR_ASSERT | (AP_TRAMPOLINE >> 12));
+        pit_delay_us(200);
+    }
+
+    for (uint32_t waited = 0; waited < AP_START_TIMEOUT_US; waited += 100)
+    {
+        if (__atomic_load_n(&cpus[cpu].online, __ATOMIC_ACQUIRE))
+        {
+            return 0;
+        }
+        pit_delay_us(100);
+    }
+    return -1;
+}
+
+void smp_init(void)
+{
+    cpus[0].online = 1;
+
+    if (!lapic_present())
+    {
+        serial_puts("[SMP] No local APIC, running on 1 CPU\n");
+        return;
+    }
+
+    /*
+     * Only the BIOS ROM area is searched; the EBDA pointer lives in
+     * page 0, which stays unmapped to catch NULL dereferences.
+     */
+    const char *source = "ACPI MADT";
+    uint32_t lapic_base = scan_acpi();
+    if (lapic_base == 0)
+    {
+        found_count = 0;
+        source = "MP table";
+        lapic_base = scan_mp();
+    }
+    if (lapic_base == 0)
+    {
+        serial_puts("[SMP] No ACPI or MP tables, running on 1 CPU\n");
+        return;
+    }
+
+    cpus[0].apic_id = lapic_id();
+
+    for (int i = 0; i < found_count; i++)
+    {
+        if (found_ids[i] == cpus[0].apic_id)
+        {
+            continue;
+        }
+
+        int cpu = cpus_online;
+        if (cpu >= MAX_CPUS)
+        {
+            break;
+        }
+        cpus[cpu].apic_id = found_ids[i];
+        if (start_ap(cpu) == 0)
+        {
+            cpus_online++;
+        }
+        else
+        {
+            serial_puts("[SMP] APIC ");
+            serial_put_dec(found_ids[i]);
+            serial_puts(" did not start\n");
+        }
+    }
+
+    serial_puts("[SMP] ");
+    serial_put_dec((uint32_t)cpus_online);
+    serial_puts(" CPU(s) online (");
+    serial_puts(source);
+    serial_puts(")\n");
+}
+
+int smp_cpu_count(void)
+{
+    return cpus_online;
+}
+
+int smp_cpu_online(int cpu)
+{
+    return cpu >= 0 && cpu < MAX_CPUS && cpus[cpu].online;
+}
+
+void smp_kick(int cpu)
+{
+    if (cpu != smp_cpu_id() && smp_cpu_online(cpu))
+    {
+        lapic_send_ipi(cpus[cpu].apic_id, ICR_ASSERT | LAPIC_KICK_VECTOR);
+    }
+}
+
+void smp_kick_all(void)
+{
+    for (int cpu = 0; cpu < cpus_online; cpu++)
+    {
+        smp_kick(cpu);
+    }
+}
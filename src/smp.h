@@ -0,0 +1,38 @@
+/* smp.h - Processor discovery, AP startup and per-CPU identity */
+#ifndef KACCHI_SMP_H
+#define KACCHI_SMP_H
+
+#include "types.h"
+#include "gdt.h"
+
+/*
+ * Index of the calling CPU, 0 for the boot CPU. Every CPU runs on its
+ * own TSS (GDT_TSS + 8 * n), so the task register says who we are
+ * without touching memory.
+ */
+static inline int smp_cpu_id(void)
+{
+    uint16_t sel;
+    __asm__ volatile("str %0" : "=r"(sel));
+    return sel < GDT_TSS ? 0 : (sel - GDT_TSS) >> 3;
+}
+
+/*
+ * Find the processors (ACPI MADT, else the MP tables) and start every
+ * AP. Needs the boot CPU's local APIC (lapic_init) and a calibrated
+ * timer (timer_init). APs park in the scheduler until it runs.
+ */
+void smp_init(void);
+
+/* CPUs online (1 until smp_init has run) */
+int smp_cpu_count(void);
+
+int smp_cpu_online(int cpu);
+
+/* Wake 'cpu' from timer_idle() with an IPI (no-op for the caller itself) */
+void smp_kick(int cpu);
+
+/* Kick every other online CPU */
+void smp_kick_all(void);
+
+#endif /* KACCHI_SMP_H */
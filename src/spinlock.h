@@ -0,0 +1,39 @@
+/* spinlock.h - Ticket spinlocks shared by the CPUs */
+#ifndef KACCHI_SPINLOCK_H
+#define KACCHI_SPINLOCK_H
+
+#include "types.h"
+
+/*
+ * Ticket lock: waiters take a number and are served in order, so no
+ * CPU starves. Kernel code runs with interrupts enabled, but interrupt
+ * handlers never take a lock, so there is no irqsave variant.
+ */
+typedef struct
+{
+    volatile uint16_t next;  /* next ticket to hand out */
+    volatile uint16_t owner; /* ticket being served */
+} spinlock_t;
+
+#define SPINLOCK_INIT {0, 0}
+
+static inline void cpu_relax(void)
+{
+    __asm__ volatile("pause" ::: "memory");
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket)
+    {
+        cpu_relax();
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+#endif /* KACCHI_SPINLOCK_H */
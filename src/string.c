@@ -48,4 +48,41 @@ int string_starts_with(const char *str, const char *prefix)
         prefix++;
     }
     return 1;
+}
+
+void *memset(void *dest, int value, size_t count)
+{
+    uint32_t pattern = (uint8_t)value;
+    pattern |= pattern << 8;
+    pattern |= pattern << 16;
+
+    void *d = dest;
+    size_t words = count >> 2;
+    size_t bytes = count & 3;
+    __asm__ volatile("rep stosl"
+                     : "+D"(d), "+c"(words)
+                     : "a"(pattern)
+                     : "memory");
+    __asm__ volatile("rep stosb"
+                     : "+D"(d), "+c"(bytes)
+                     : "a"(pattern)
+                     : "memory");
+    return dest;
+}
+
+void *memcpy(void *dest, const void *src, size_t count)
+{
+    void *d = dest;
+    const void *s = src;
+    size_t words = count >> 2;
+    size_t bytes = count & 3;
+    __asm__ volatile("rep movsl"
+                     : "+D"(d), "+S"(s), "+c"(words)
+                     :
+                     : "memory");
+    __asm__ volatile("rep movsb"
+                     : "+D"(d), "+S"(s), "+c"(bytes)
+                     :
+                     : "memory");
+    return dest;
 }
\ No newline at end of file
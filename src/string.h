@@ -10,4 +10,8 @@ char *strcpy(char *dest, const char *src);
 int string_equal(const char *s1, const char *s2);
 int string_starts_with(const char *str, const char *prefix);
 
+/* Block fill/copy: whole dwords via rep stosl/movsl, then the byte tail */
+void *memset(void *dest, int value, size_t count);
+void *memcpy(void *dest, const void *src, size_t count);
+
 #endif
\ No newline at end of file
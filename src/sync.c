@@ -0,0 +1,235 @@
+/* sync.c - Wait queues, semaphores, mutexes and futex-style wait/wake */
+#include "sync.h"
+#include "paging.h"
+#include "process.h"
+#include "scheduler.h"
+
+#define FUTEX_BUCKETS 64 /* power of two */
+
+/* Futex waiters hashed by (address space, address); a bucket holds any keys that collide */
+static wait_queue_t futex_table[FUTEX_BUCKETS] = {
+    [0 ... FUTEX_BUCKETS - 1] = WAIT_QUEUE_INIT,
+};
+
+static volatile uint32_t futex_sleep_count = 0;
+
+/* ---------------- Wait queues (caller holds q->lock) ------------------ */
+
+static void wq_push(wait_queue_t *q, int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    pcb->wq_next = -1;
+    pcb->wait_queue = q;
+    if (q->tail < 0)
+        q->head = pid;
+    else
+        proc_get_pcb(q->tail)->wq_next = pid;
+    q->tail = pid;
+}
+
+/* Unlink 'pid', which follows 'prev' (-1 if it is the head) */
+static void wq_unlink(wait_queue_t *q, int32_t prev, int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    if (prev < 0)
+        q->head = pcb->wq_next;
+    else
+        proc_get_pcb(prev)->wq_next = pcb->wq_next;
+    if (q->tail == pid)
+        q->tail = prev;
+    pcb->wq_next = -1;
+    pcb->wait_queue = NULL;
+}
+
+/* Make the oldest waiter READY; -1 if there is none */
+static int32_t wq_wake_one(wait_queue_t *q)
+{
+    int32_t pid = q->head;
+    if (pid < 0)
+        return -1;
+    wq_unlink(q, -1, pid);
+    proc_set_state(pid, PR_READY);
+    return pid;
+}
+
+void sync_cancel_wait(int32_t pid)
+{
+    pcb_t *pcb = proc_get_pcb(pid);
+    wait_queue_t *q = pcb ? (wait_queue_t *)pcb->wait_queue : NULL;
+    if (q == NULL)
+        return;
+
+    spin_lock(&q->lock);
+    if (pcb->wait_queue == q) /* a waker may have taken it off meanwhile */
+    {
+        int32_t prev = -1;
+        for (int32_t cur = q->head; cur >= 0 && cur != pid; cur = proc_get_pcb(cur)->wq_next)
+            prev = cur;
+        wq_unlink(q, prev, pid);
+    }
+    spin_unlock(&q->lock);
+}
+
+/* ---------------- Semaphores ------------------------------------------ */
+
+void sem_init(semaphore_t *sem, int32_t count)
+{
+    sem->count = count;
+    sem->wakeups = 0;
+    sem->wq = (wait_queue_t)WAIT_QUEUE_INIT;
+}
+
+void sem_down(semaphore_t *sem)
+{
+    if (__atomic_sub_fetch(&sem->count, 1, __ATOMIC_ACQUIRE) >= 0)
+        return;
+
+    /* Contended: wait for an up to hand its unit over */
+    int32_t pid = scheduler_current_pid();
+    while (1)
+    {
+        spin_lock(&sem->wq.lock);
+        if (sem->wakeups > 0)
+        {
+            sem->wakeups--;
+            spin_unlock(&sem->wq.lock);
+            return;
+        }
+        if (pid >= 0)
+        {
+            wq_push(&sem->wq, pid);
+            scheduler_block_unlock(&sem->wq.lock);
+            return; /* sem_up() dequeued us: the unit is ours */
+        }
+        spin_unlock(&sem->wq.lock); /* the shell cannot sleep */
+        cpu_relax();
+    }
+}
+
+int sem_try_down(semaphore_t *sem)
+{
+    int32_t count = sem->count;
+    while (count > 0)
+    {
+        if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+            return 0;
+    }
+    return -1;
+}
+
+void sem_up(semaphore_t *sem)
+{
+    if (__atomic_add_fetch(&sem->count, 1, __ATOMIC_RELEASE) > 0)
+        return;
+
+    /* Someone went negative: wake it, or leave the unit for it to collect */
+    spin_lock(&sem->wq.lock);
+    if (wq_wake_one(&sem->wq) < 0)
+        sem->wakeups++;
+    spin_unlock(&sem->wq.lock);
+}
+
+/* ---------------- Mutexes --------------------------------------------- */
+
+void mutex_init(mutex_t *mutex)
+{
+    mutex->state = 0;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+    uint32_t c = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    /* Mark it contended so the holder's unlock wakes us */
+    if (c != 2)
+        c = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (c != 0)
+    {
+        futex_wait(&mutex->state, 2);
+        c = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+    if (__atomic_fetch_sub(&mutex->state, 1, __ATOMIC_RELEASE) != 1)
+    {
+        __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+        futex_wake(&mutex->state, 1);
+    }
+}
+
+/* ---------------- Futexes --------------------------------------------- */
+
+/* The identity map is the same in every space; the rest is per process */
+static uint32_t *futex_space(uint32_t addr)
+{
+    return addr < PAGING_IDENTITY_BYTES ? NULL : paging_current();
+}
+
+static wait_queue_t *futex_bucket(uint32_t *space, uint32_t addr)
+{
+    uint32_t h = ((addr >> 2) ^ ((uint32_t)space >> 12)) * 0x9E3779B1u;
+    return &futex_table[h >> 26]; /* top log2(FUTEX_BUCKETS) bits */
+}
+
+int futex_wait(volatile uint32_t *addr, uint32_t expected)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return -1;
+
+    uint32_t *space = futex_space((uint32_t)addr);
+    wait_queue_t *q = futex_bucket(space, (uint32_t)addr);
+
+    /* Wakers change the value before taking the bucket lock, so this check cannot go stale */
+    spin_lock(&q->lock);
+    if (*addr != expected)
+    {
+        spin_unlock(&q->lock);
+        return -1;
+    }
+
+    pcb_t *pcb = proc_get_pcb(pid);
+    pcb->wait_space = space;
+    pcb->wait_addr = (uint32_t)addr;
+    wq_push(q, pid);
+    __atomic_add_fetch(&futex_sleep_count, 1, __ATOMIC_RELAXED);
+    scheduler_block_unlock(&q->lock);
+    return 0;
+}
+
+int futex_wake(volatile uint32_t *addr, uint32_t count)
+{
+    uint32_t *space = futex_space((uint32_t)addr);
+    wait_queue_t *q = futex_bucket(space, (uint32_t)addr);
+    int woken = 0;
+
+    spin_lock(&q->lock);
+    int32_t prev = -1;
+    int32_t pid = q->head;
+    while (pid >= 0 && (uint32_t)woken < count)
+    {
+        pcb_t *pcb = proc_get_pcb(pid);
+        int32_t next = pcb->wq_next;
+        if (pcb->wait_addr == (uint32_t)addr && pcb->wait_space == space)
+        {
+            wq_unlink(q, prev, pid);
+            proc_set_state(pid, PR_READY);
+            woken++;
+        }
+        else
+            prev = pid;
+        pid = next;
+    }
+    spin_unlock(&q->lock);
+    return woken;
+}
+
+uint32_t futex_sleeps(void)
+{
+    return futex_sleep_count;
+}
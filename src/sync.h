@@ -0,0 +1,71 @@
+/* sync.h - Wait queues, semaphores, mutexes and futex-style wait/wake */
+#ifndef KACCHI_SYNC_H
+#define KACCHI_SYNC_H
+
+#include "spinlock.h"
+#include "types.h"
+
+/* FIFO of PR_BLOCKED processes, linked through pcb->wq_next */
+typedef struct
+{
+    spinlock_t lock;
+    int32_t head; /* -1 when empty */
+    int32_t tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT {SPINLOCK_INIT, -1, -1}
+
+/*
+ * Counting semaphore. 'count' below zero is minus the number of
+ * processes on their way to (or in) the wait queue; down and up are a
+ * single atomic each until that happens.
+ */
+typedef struct
+{
+    volatile int32_t count;
+    uint32_t wakeups; /* ups that found no waiter queued yet (under wq.lock) */
+    wait_queue_t wq;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(n) {(n), 0, WAIT_QUEUE_INIT}
+
+/*
+ * Sleeping mutex on a futex word: 0 unlocked, 1 locked, 2 locked with
+ * (possible) waiters. Lock and unlock are one atomic when uncontended.
+ */
+typedef struct
+{
+    volatile uint32_t state;
+} mutex_t;
+
+#define MUTEX_INIT {0}
+
+void sem_init(semaphore_t *sem, int32_t count);
+void sem_down(semaphore_t *sem);
+int sem_try_down(semaphore_t *sem); /* 0 on success, -1 if it would block */
+void sem_up(semaphore_t *sem);
+
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+/*
+ * Block the running process while *addr == expected, until
+ * futex_wake() on the same address. Addresses in the shared identity
+ * map are one key for every process; anything above it is private to
+ * the calling address space. Returns 0 once woken, -1 if the value had
+ * already changed (or there is no process to block: the caller
+ * retries, which makes the shell spin).
+ */
+int futex_wait(volatile uint32_t *addr, uint32_t expected);
+
+/* Wake up to 'count' processes waiting on 'addr'; returns how many */
+int futex_wake(volatile uint32_t *addr, uint32_t count);
+
+/* Blocking futex_wait() calls since boot */
+uint32_t futex_sleeps(void);
+
+/* Take a terminated process off whatever wait queue it sleeps on */
+void sync_cancel_wait(int32_t pid);
+
+#endif /* KACCHI_SYNC_H */
@@ -0,0 +1,291 @@
+/* syscall.c - System call table and the two ring-3 entry paths */
+#include "syscall.h"
+#include "chan.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "idt.h"
+#include "memory.h"
+#include "paging.h"
+#include "process.h"
+#include "ramfs.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "sync.h"
+#include "timer.h"
+#include "waitset.h"
+
+typedef uint32_t (*syscall_fn)(const uint32_t *args);
+
+/* Entry stubs (isr.S) */
+extern void sysenter_entry(void);
+extern void isr128(void);
+
+/* ---------------- Argument checks ------------------------------------- */
+
+/* A NUL-terminated string the caller may read, checked page by page */
+static int user_string_ok(uint32_t va)
+{
+    while (proc_user_ok(va, 1, 0))
+    {
+        uint32_t page_end = (va & PTE_FRAME) + PAGE_SIZE;
+        for (; va != page_end; va++)
+        {
+            if (*(const char *)va == '\0')
+            {
+                return 1;
+            }
+        }
+        if (page_end == 0)
+        {
+            break; /* ran off the top of the address space */
+        }
+    }
+    return 0;
+}
+
+/* ---------------- Calls ----------------------------------------------- */
+
+static uint32_t do_exit(const uint32_t *args)
+{
+    (void)args;
+    scheduler_exit();
+    return 0;
+}
+
+static uint32_t do_yield(const uint32_t *args)
+{
+    (void)args;
+    scheduler_yield();
+    return 0;
+}
+
+static uint32_t do_getpid(const uint32_t *args)
+{
+    (void)args;
+    return (uint32_t)scheduler_current_pid();
+}
+
+static uint32_t do_puts(const uint32_t *args)
+{
+    if (!user_string_ok(args[0]))
+        return SYSCALL_ERROR;
+    serial_puts((const char *)args[0]);
+    return 0;
+}
+
+static uint32_t do_put_dec(const uint32_t *args)
+{
+    serial_put_dec(args[0]);
+    return 0;
+}
+
+static uint32_t do_heap_alloc(const uint32_t *args)
+{
+    return (uint32_t)proc_heap_alloc(args[0]);
+}
+
+static uint32_t do_heap_free(const uint32_t *args)
+{
+    return proc_heap_free((void *)args[0]) == 0 ? 0 : SYSCALL_ERROR;
+}
+
+static uint32_t do_proc_alloc(const uint32_t *args)
+{
+    return (uint32_t)proc_alloc(args[0]);
+}
+
+static uint32_t do_send(const uint32_t *args)
+{
+    if (!user_string_ok(args[1]))
+        return SYSCALL_ERROR;
+    return (uint32_t)proc_send((int32_t)args[0], (const char *)args[1]);
+}
+
+static uint32_t do_recv(const uint32_t *args)
+{
+    if (!proc_user_ok(args[0], IPC_MSG_SIZE, 1))
+        return SYSCALL_ERROR;
+    return (uint32_t)proc_recv(scheduler_current_pid(), (char *)args[0]);
+}
+
+static uint32_t do_fork(const uint32_t *args)
+{
+    (void)args;
+    return (uint32_t)proc_fork();
+}
+
+static uint32_t do_null(const uint32_t *args)
+{
+    (void)args;
+    return 0;
+}
+
+static uint32_t do_sleep(const uint32_t *args)
+{
+    scheduler_sleep_until(clock_ns() + (uint64_t)args[0] * NS_PER_MS);
+    return 0;
+}
+
+static uint32_t do_uptime(const uint32_t *args)
+{
+    (void)args;
+    return timer_ns_to_ms(clock_ns());
+}
+
+static uint32_t do_futex_wait(const uint32_t *args)
+{
+    if ((args[0] & 3) || !proc_user_ok(args[0], 4, 0))
+        return SYSCALL_ERROR;
+    return (uint32_t)futex_wait((volatile uint32_t *)args[0], args[1]);
+}
+
+static uint32_t do_futex_wake(const uint32_t *args)
+{
+    if ((args[0] & 3) || !proc_user_ok(args[0], 4, 0))
+        return SYSCALL_ERROR;
+    return (uint32_t)futex_wake((volatile uint32_t *)args[0], args[1]);
+}
+
+static uint32_t do_chan_create(const uint32_t *args)
+{
+    (void)args;
+    return (uint32_t)chan_create();
+}
+
+static uint32_t do_chan_send(const uint32_t *args)
+{
+    if (!user_string_ok(args[1]))
+        return SYSCALL_ERROR;
+    return (uint32_t)chan_send((int32_t)args[0], (const char *)args[1]);
+}
+
+static uint32_t do_chan_recv(const uint32_t *args)
+{
+    if (!proc_user_ok(args[1], IPC_MSG_SIZE, 1))
+        return SYSCALL_ERROR;
+    return (uint32_t)chan_recv((int32_t)args[0], (char *)args[1]);
+}
+
+static uint32_t do_edf_set(const uint32_t *args)
+{
+    return (uint32_t)scheduler_set_edf(args[0], args[1], args[2]);
+}
+
+static uint32_t do_edf_wait(const uint32_t *args)
+{
+    (void)args;
+    return (uint32_t)scheduler_edf_wait();
+}
+
+static uint32_t do_ws_add(const uint32_t *args)
+{
+    return (uint32_t)waitset_add((int)args[0], (int32_t)args[1]);
+}
+
+static uint32_t do_ws_remove(const uint32_t *args)
+{
+    return (uint32_t)waitset_remove((int)args[0]);
+}
+
+static uint32_t do_ws_wait(const uint32_t *args)
+{
+    if (args[1] == 0 || args[1] > WAITSET_MAX ||
+        !proc_user_ok(args[0], args[1] * sizeof(int32_t), 1))
+        return SYSCALL_ERROR;
+    return (uint32_t)waitset_wait((int32_t *)args[0], (int)args[1], args[2]);
+}
+
+static uint32_t do_fs_open(const uint32_t *args)
+{
+    if (!user_string_ok(args[0]))
+        return SYSCALL_ERROR;
+    return (uint32_t)ramfs_open((const char *)args[0]);
+}
+
+static uint32_t do_fs_size(const uint32_t *args)
+{
+    return ramfs_size((int)args[0]);
+}
+
+static uint32_t do_fs_map(const uint32_t *args)
+{
+    return ramfs_map_user((int)args[0]);
+}
+
+static const syscall_fn syscall_table[SYS_COUNT] = {
+    [SYS_EXIT] = do_exit,
+    [SYS_YIELD] = do_yield,
+    [SYS_GETPID] = do_getpid,
+    [SYS_PUTS] = do_puts,
+    [SYS_PUT_DEC] = do_put_dec,
+    [SYS_HEAP_ALLOC] = do_heap_alloc,
+    [SYS_HEAP_FREE] = do_heap_free,
+    [SYS_PROC_ALLOC] = do_proc_alloc,
+    [SYS_SEND] = do_send,
+    [SYS_RECV] = do_recv,
+    [SYS_FORK] = do_fork,
+    [SYS_NULL] = do_null,
+    [SYS_SLEEP] = do_sleep,
+    [SYS_UPTIME] = do_uptime,
+    [SYS_FUTEX_WAIT] = do_futex_wait,
+    [SYS_FUTEX_WAKE] = do_futex_wake,
+    [SYS_CHAN_CREATE] = do_chan_create,
+    [SYS_CHAN_SEND] = do_chan_send,
+    [SYS_CHAN_RECV] = do_chan_recv,
+    [SYS_WS_ADD] = do_ws_add,
+    [SYS_WS_REMOVE] = do_ws_remove,
+    [SYS_WS_WAIT] = do_ws_wait,
+    [SYS_EDF_SET] = do_edf_set,
+    [SYS_EDF_WAIT] = do_edf_wait,
+    [SYS_FS_OPEN] = do_fs_open,
+    [SYS_FS_SIZE] = do_fs_size,
+    [SYS_FS_MAP] = do_fs_map,
+};
+
+/* ---------------- Entry ----------------------------------------------- */
+
+uint32_t syscall_dispatch(uint32_t nr, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    if (nr >= SYS_COUNT || scheduler_current_pid() < 0)
+    {
+        return SYSCALL_ERROR;
+    }
+
+    uint32_t args[3] = {a0, a1, a2};
+    return syscall_table[nr](args);
+}
+
+/* Slow path: the int 0x80 stub saved every register in the frame */
+static void syscall_int80(isr_frame_t *frame)
+{
+    frame->eax = syscall_dispatch(frame->eax, frame->ebx, frame->esi, frame->edi);
+}
+
+void syscall_init(void)
+{
+    /* Both paths land on the running process's kernel stack */
+    gdt_set_kernel_stack(PROC_KSTACK_TOP);
+
+    idt_set_handler(SYSCALL_VECTOR, syscall_int80);
+    idt_set_user_gate(SYSCALL_VECTOR, isr128);
+
+    if (syscall_init_cpu() != 0)
+    {
+        serial_puts("[WARN] CPU lacks SYSENTER; only int 0x80 will work\n");
+    }
+}
+
+int syscall_init_cpu(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    if (!(d & CPUID_EDX_SEP))
+    {
+        return -1;
+    }
+
+    wrmsr(MSR_SYSENTER_CS, GDT_KCODE);
+    wrmsr(MSR_SYSENTER_ESP, PROC_KSTACK_TOP);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    return 0;
+}
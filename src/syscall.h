@@ -0,0 +1,55 @@
+/* syscall.h - System call numbers and kernel-side dispatch */
+#ifndef KACCHI_SYSCALL_H
+#define KACCHI_SYSCALL_H
+
+#include "types.h"
+
+/*
+ * Call numbers, shared with the ring-3 stubs in usys.h. Both entry
+ * paths (SYSENTER and int 0x80) use the same registers: number in EAX,
+ * arguments in EBX, ESI, EDI, result in EAX.
+ */
+#define SYS_EXIT 0       /* (void) - does not return */
+#define SYS_YIELD 1      /* (void) */
+#define SYS_GETPID 2     /* () -> pid */
+#define SYS_PUTS 3       /* (const char *s) */
+#define SYS_PUT_DEC 4    /* (uint32_t value) */
+#define SYS_HEAP_ALLOC 5 /* (size_t size) -> ptr in the caller's own heap or NULL */
+#define SYS_HEAP_FREE 6  /* (void *ptr) - a block from SYS_HEAP_ALLOC */
+#define SYS_PROC_ALLOC 7 /* (size_t size) -> arena ptr or NULL */
+#define SYS_SEND 8       /* (pid, const char *msg) */
+#define SYS_RECV 9       /* (char out[IPC_MSG_SIZE]) - own mailbox */
+#define SYS_FORK 10      /* () -> child pid / 0 in the child */
+#define SYS_NULL 11      /* () -> 0, for measuring entry/exit cost */
+#define SYS_SLEEP 12     /* (uint32_t ms) */
+#define SYS_UPTIME 13    /* () -> milliseconds on the monotonic clock */
+#define SYS_FUTEX_WAIT 14 /* (uint32_t *addr, expected) -> 0 woken / -1 value changed */
+#define SYS_FUTEX_WAKE 15 /* (uint32_t *addr, count) -> processes woken */
+#define SYS_CHAN_CREATE 16 /* () -> channel id */
+#define SYS_CHAN_SEND 17   /* (id, const char *msg) - -1 if full */
+#define SYS_CHAN_RECV 18   /* (id, char out[IPC_MSG_SIZE]) - -1 if empty */
+#define SYS_WS_ADD 19      /* (WS_* type, id) -> wait-set slot */
+#define SYS_WS_REMOVE 20   /* (slot) */
+#define SYS_WS_WAIT 21     /* (int32_t *out, max, timeout_ms) -> ready slots written */
+#define SYS_EDF_SET 22     /* (runtime_us, period_us, deadline_us) - -1 if not admitted */
+#define SYS_EDF_WAIT 23    /* () -> 1 if the job just ended missed its deadline */
+#define SYS_FS_OPEN 24     /* (const char *name) -> ramfs descriptor */
+#define SYS_FS_SIZE 25     /* (fd) -> bytes */
+#define SYS_FS_MAP 26      /* (fd) -> read-only address of the whole file, 0 on failure */
+#define SYS_COUNT 27
+
+/* Returned for unknown calls and rejected arguments */
+#define SYSCALL_ERROR 0xFFFFFFFFu
+
+#define SYSCALL_VECTOR 0x80
+
+/* Install the int 0x80 gate and program the SYSENTER MSRs. */
+void syscall_init(void);
+
+/* Program the SYSENTER MSRs on the calling CPU; -1 if it has none. */
+int syscall_init_cpu(void);
+
+/* Run call 'nr' for the current process; shared by both entry paths. */
+uint32_t syscall_dispatch(uint32_t nr, uint32_t a0, uint32_t a1, uint32_t a2);
+
+#endif /* KACCHI_SYSCALL_H */
@@ -0,0 +1,274 @@
+/* task.c - Stackless tasks multiplexed by an executor inside one process */
+#include "task.h"
+#include "usys.h"
+
+/* Ring-3 code: everything here touches only the caller's memory and system calls */
+
+/* task_t.state values */
+#define TS_FREE 0
+#define TS_READY 1
+#define TS_TIMER 2
+#define TS_CHANNEL 3
+#define TS_MAILBOX 4
+
+void executor_init(executor_t *ex, task_t *tasks, uint32_t capacity, void *ctx)
+{
+    ex->tasks = tasks;
+    ex->capacity = capacity;
+    ex->live = 0;
+    ex->run_head = ex->run_tail = TASK_NONE;
+
+    /* Free list in index order, so spawning fills the array front to back */
+    ex->free_head = capacity ? 0 : TASK_NONE;
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        tasks[i].fn = NULL;
+        tasks[i].state = TS_FREE;
+        tasks[i].next = i + 1 < capacity ? (int32_t)(i + 1) : TASK_NONE;
+    }
+
+    for (int s = 0; s < TASK_WHEEL; s++)
+        ex->wheel[s] = TASK_NONE;
+    ex->sleepers = 0;
+    ex->clock_ms = sys_uptime();
+
+    for (int c = 0; c < CHAN_MAX; c++)
+    {
+        ex->chan_waiters[c] = TASK_NONE;
+        ex->chan_slot[c] = -1;
+    }
+    ex->mail_waiters = TASK_NONE;
+    ex->mail_slot = -1;
+    ex->watched = 0;
+
+    ex->ctx = ctx;
+    ex->runs = ex->passes = ex->waits = 0;
+}
+
+static void make_ready(executor_t *ex, int32_t index)
+{
+    task_t *t = &ex->tasks[index];
+    t->state = TS_READY;
+    t->next = TASK_NONE;
+    if (ex->run_tail == TASK_NONE)
+        ex->run_head = index;
+    else
+        ex->tasks[ex->run_tail].next = index;
+    ex->run_tail = index;
+}
+
+int32_t task_spawn(executor_t *ex, task_fn_t fn, uint32_t arg)
+{
+    int32_t index = ex->free_head;
+    if (index == TASK_NONE || fn == NULL)
+        return -1;
+
+    task_t *t = &ex->tasks[index];
+    ex->free_head = t->next;
+    t->fn = fn;
+    t->resume = 0;
+    t->arg = arg;
+    ex->live++;
+    make_ready(ex, index);
+    return index;
+}
+
+void task_wait_timer(executor_t *ex, task_t *t, uint32_t ms)
+{
+    int32_t index = (int32_t)(t - ex->tasks);
+    if (ms == 0)
+    {
+        make_ready(ex, index);
+        return;
+    }
+
+    /* Never behind clock_ms: the wheel has already passed those slots */
+    t->due_ms = sys_uptime() + ms;
+    if ((int32_t)(t->due_ms - ex->clock_ms) < 0)
+        t->due_ms = ex->clock_ms;
+
+    int32_t *slot = &ex->wheel[t->due_ms % TASK_WHEEL];
+    t->state = TS_TIMER;
+    t->next = *slot;
+    *slot = index;
+    ex->sleepers++;
+}
+
+int task_wait_chan(executor_t *ex, task_t *t, int32_t chan)
+{
+    if (chan < 0 || chan >= CHAN_MAX)
+        return -1;
+
+    /* Watched from the first waiter until the executor finishes */
+    if (ex->chan_slot[chan] < 0)
+    {
+        int slot = sys_ws_add(WS_CHANNEL, chan);
+        if (slot < 0)
+            return -1;
+        ex->chan_slot[chan] = (int8_t)slot;
+        ex->watched++;
+    }
+
+    t->state = TS_CHANNEL;
+    t->chan = (uint8_t)chan;
+    t->next = ex->chan_waiters[chan];
+    ex->chan_waiters[chan] = (int32_t)(t - ex->tasks);
+    return 0;
+}
+
+int task_wait_mail(executor_t *ex, task_t *t)
+{
+    if (ex->mail_slot < 0)
+    {
+        int slot = sys_ws_add(WS_MAILBOX, sys_getpid());
+        if (slot < 0)
+            return -1;
+        ex->mail_slot = slot;
+        ex->watched++;
+    }
+
+    t->state = TS_MAILBOX;
+    t->next = ex->mail_waiters;
+    ex->mail_waiters = (int32_t)(t - ex->tasks);
+    return 0;
+}
+
+/* An edge on a source wakes all of its waiters; the ones that find nothing park again */
+static void wake_list(executor_t *ex, int32_t *list)
+{
+    int32_t index = *list;
+    *list = TASK_NONE;
+    while (index != TASK_NONE)
+    {
+        int32_t next = ex->tasks[index].next;
+        make_ready(ex, index);
+        index = next;
+    }
+}
+
+/* Expire one wheel slot; later laps of the wheel stay put */
+static void expire_slot(executor_t *ex, uint32_t slot, uint32_t now)
+{
+    int32_t *link = &ex->wheel[slot];
+    while (*link != TASK_NONE)
+    {
+        int32_t index = *link;
+        task_t *t = &ex->tasks[index];
+        if ((int32_t)(t->due_ms - now) <= 0)
+        {
+            *link = t->next;
+            ex->sleepers--;
+            make_ready(ex, index);
+        }
+        else
+            link = &t->next;
+    }
+}
+
+/* Move every timer due by 'now' to the run queue */
+static void advance_wheel(executor_t *ex, uint32_t now)
+{
+    if ((int32_t)(now - ex->clock_ms) < 0)
+        return; /* expired up to 'now' already */
+
+    /* A gap of a whole lap or more visits each slot once */
+    uint32_t steps = now - ex->clock_ms + 1;
+    if (steps > TASK_WHEEL)
+        steps = TASK_WHEEL;
+    for (uint32_t i = 0; i < steps && ex->sleepers; i++)
+        expire_slot(ex, (ex->clock_ms + i) % TASK_WHEEL, now);
+    ex->clock_ms = now + 1;
+}
+
+/* How long the process may sleep: until the nearest occupied wheel slot */
+static uint32_t wheel_timeout(executor_t *ex, uint32_t now)
+{
+    if (ex->sleepers == 0)
+        return WS_FOREVER;
+
+    for (uint32_t d = 0; d < TASK_WHEEL; d++)
+    {
+        uint32_t ms = ex->clock_ms + d;
+        if (ex->wheel[ms % TASK_WHEEL] == TASK_NONE)
+            continue;
+        /* Possibly a later lap: then we wake early and look again */
+        return (int32_t)(ms - now) > 0 ? ms - now : 0;
+    }
+    return 0;
+}
+
+static void run_task(executor_t *ex, int32_t index)
+{
+    task_t *t = &ex->tasks[index];
+    int result = t->fn(ex, t);
+    ex->runs++;
+
+    if (result == TASK_DONE)
+    {
+        t->fn = NULL;
+        t->state = TS_FREE;
+        t->next = ex->free_head;
+        ex->free_head = index;
+        ex->live--;
+    }
+    else if (result == TASK_YIELDED)
+        make_ready(ex, index);
+    /* TASK_WAITING: the wait macro has parked it already */
+}
+
+void executor_run(executor_t *ex)
+{
+    while (ex->live > 0)
+    {
+        /* One pass over what is runnable now; tasks readied meanwhile go next pass */
+        int32_t index = ex->run_head;
+        ex->run_head = ex->run_tail = TASK_NONE;
+        while (index != TASK_NONE)
+        {
+            int32_t next = ex->tasks[index].next;
+            run_task(ex, index);
+            index = next;
+        }
+        ex->passes++;
+        if (ex->live == 0)
+            break;
+
+        uint32_t now = sys_uptime();
+        advance_wheel(ex, now);
+
+        /* Runnable tasks left: only poll, and skip even that with nothing watched */
+        uint32_t timeout = ex->run_head != TASK_NONE ? 0 : wheel_timeout(ex, now);
+        if (timeout != 0 || ex->watched > 0)
+        {
+            int32_t ready[WAITSET_MAX];
+            int n = sys_ws_wait(ready, WAITSET_MAX, timeout);
+            if (timeout != 0)
+                ex->waits++;
+            for (int r = 0; r < n; r++)
+            {
+                if (ready[r] == ex->mail_slot)
+                {
+                    wake_list(ex, &ex->mail_waiters);
+                    continue;
+                }
+                for (int c = 0; c < CHAN_MAX; c++)
+                {
+                    if (ex->chan_slot[c] == ready[r])
+                        wake_list(ex, &ex->chan_waiters[c]);
+                }
+            }
+            advance_wheel(ex, sys_uptime());
+        }
+    }
+
+    for (int c = 0; c < CHAN_MAX; c++)
+    {
+        if (ex->chan_slot[c] >= 0)
+            sys_ws_remove(ex->chan_slot[c]);
+        ex->chan_slot[c] = -1;
+    }
+    if (ex->mail_slot >= 0)
+        sys_ws_remove(ex->mail_slot);
+    ex->mail_slot = -1;
+    ex->watched = 0;
+}
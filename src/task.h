@@ -0,0 +1,135 @@
+/* task.h - Stackless tasks multiplexed by an executor inside one process */
+#ifndef KACCHI_TASK_H
+#define KACCHI_TASK_H
+
+#include "types.h"
+#include "chan.h"
+
+#define TASK_NONE (-1)   /* empty list link */
+#define TASK_WHEEL 256   /* timer wheel slots, one per millisecond */
+
+/* What a task body returns to the executor (the macros below do it) */
+#define TASK_YIELDED 0 /* runnable again, after everything already queued */
+#define TASK_WAITING 1 /* parked on a timer, a channel or the mailbox */
+#define TASK_DONE 2    /* finished; the control block is free again */
+
+typedef struct task task_t;
+typedef struct executor executor_t;
+typedef int (*task_fn_t)(executor_t *ex, task_t *t);
+
+/*
+ * A task is a function re-entered from the top on every run. It has no
+ * stack of its own: TASK_BEGIN jumps back to the line it stopped at, so
+ * locals do not survive a wait; anything that must lives in 'arg' or
+ * behind the executor's 'ctx'. 20 bytes per task, all of it here.
+ */
+struct task
+{
+    task_fn_t fn;    /* NULL while the block is free */
+    uint16_t resume; /* source line of the wait to continue from, 0 at the start */
+    uint8_t state;   /* executor bookkeeping */
+    uint8_t chan;    /* channel it waits on */
+    int32_t next;    /* run queue, wait list or free list link */
+    uint32_t arg;    /* the task's own word: a counter, an index, a pointer */
+    uint32_t due_ms; /* timer deadline on sys_uptime() */
+};
+
+/*
+ * Runs every task of one ring-3 process on that process's stack. While
+ * nothing is runnable it sleeps in the process's wait set, watching the
+ * channels and the mailbox tasks wait on, with the nearest timer as the
+ * timeout. Lives in process memory: the caller provides it and the task
+ * array, typically as locals of the process body.
+ */
+struct executor
+{
+    task_t *tasks;
+    uint32_t capacity;
+    uint32_t live;     /* spawned and not done */
+    int32_t free_head;
+    int32_t run_head, run_tail;
+
+    int32_t wheel[TASK_WHEEL]; /* sleepers hashed by due_ms */
+    uint32_t sleepers;
+    uint32_t clock_ms;         /* next wheel millisecond to expire */
+
+    int32_t chan_waiters[CHAN_MAX];
+    int8_t chan_slot[CHAN_MAX]; /* wait set slot watching it, -1 if none */
+    int32_t mail_waiters;
+    int mail_slot;
+    int watched;                /* wait set slots in use */
+
+    void *ctx;                  /* shared by the tasks, owned by the caller */
+
+    uint32_t runs;   /* task bodies entered */
+    uint32_t passes; /* trips through the run queue */
+    uint32_t waits;  /* times the process slept in its wait set */
+};
+
+/* Prepare 'ex' to run up to 'capacity' tasks in the caller's 'tasks' array */
+void executor_init(executor_t *ex, task_t *tasks, uint32_t capacity, void *ctx);
+
+/* Queue fn(ex, t) with t->arg = arg; returns its index, -1 if all blocks are in use */
+int32_t task_spawn(executor_t *ex, task_fn_t fn, uint32_t arg);
+
+/* Run until every task is done, then drop the wait set slots it added */
+void executor_run(executor_t *ex);
+
+/*
+ * Park 't' (used by the macros). A wake-up means "something may have
+ * arrived": try the receive first and wait only when it fails, as the
+ * wait set reports each edge once. Channel and mailbox waits return -1
+ * if the source cannot be watched; the task then just carries on.
+ */
+void task_wait_timer(executor_t *ex, task_t *t, uint32_t ms);
+int task_wait_chan(executor_t *ex, task_t *t, int32_t chan);
+int task_wait_mail(executor_t *ex, task_t *t);
+
+/* Body structure: TASK_BEGIN(t); ... TASK_END(t); with no switch statements in between */
+#define TASK_BEGIN(t)                           \
+    switch ((t)->resume)                        \
+    {                                           \
+    case 0:
+
+#define TASK_END(t)                             \
+    }                                           \
+    return TASK_DONE
+
+#define TASK_YIELD(t)                           \
+    do                                          \
+    {                                           \
+        (t)->resume = __LINE__;                 \
+        return TASK_YIELDED;                    \
+    case __LINE__:;                             \
+    } while (0)
+
+#define TASK_SLEEP(ex, t, ms)                   \
+    do                                          \
+    {                                           \
+        (t)->resume = __LINE__;                 \
+        task_wait_timer((ex), (t), (ms));       \
+        return TASK_WAITING;                    \
+    case __LINE__:;                             \
+    } while (0)
+
+#define TASK_WAIT_CHAN(ex, t, id)               \
+    do                                          \
+    {                                           \
+        (t)->resume = __LINE__;                 \
+        if (task_wait_chan((ex), (t), (id)) == 0) \
+            return TASK_WAITING;                \
+        __attribute__((fallthrough));           \
+    case __LINE__:;                             \
+    } while (0)
+
+#define TASK_WAIT_MAIL(ex, t)                   \
+    do                                          \
+    {                                           \
+        (t)->resume = __LINE__;                 \
+        if (task_wait_mail((ex), (t)) == 0)     \
+            return TASK_WAITING;                \
+        __attribute__((fallthrough));           \
+    case __LINE__:;                             \
+    } while (0)
+
+#endif /* KACCHI_TASK_H */
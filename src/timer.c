@@ -0,0 +1,321 @@
+/* timer.c - Monotonic clock, one-shot local APIC timer and tickless idle */
+#include "timer.h"
+#include "cpu.h"
+#include "idt.h"
+#include "io.h"
+#include "lapic.h"
+#include "prof.h"
+#include "serial.h"
+#include "smp.h"
+#include "spinlock.h"
+
+#define PIT_HZ 1193182
+#define CALIBRATE_US 10000
+
+/* 8259 command/data ports and the vectors the PICs are moved to */
+#define PIC1_CMD 0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD 0xA0
+#define PIC2_DATA 0xA1
+#define PIC1_VECTOR 0x20
+#define PIC2_VECTOR 0x28
+
+/* Interrupt entry stubs (isr.S) */
+extern void isr64(void);
+extern void isr65(void);
+extern void isr255(void);
+
+typedef struct
+{
+    uint64_t wake_ns;      /* deadline requested by timer_idle(), 0 if none */
+    uint64_t idle_tsc;     /* cycles spent halted */
+    uint32_t interrupts;
+} timer_cpu_t;
+
+static timer_cpu_t timer_cpus[MAX_CPUS];
+
+/* Timestamp counter rate, and its value when the clock started */
+static uint32_t tsc_khz = 0;
+static uint64_t boot_tsc = 0;
+
+/* APIC timer counts per millisecond at divide-by-16; 0 without an APIC */
+static uint32_t lapic_per_ms = 0;
+
+/* Program MSR_TSC_DEADLINE instead of counting down the APIC timer */
+static int use_tsc_deadline = 0;
+
+/* n / d without libgcc's 64-bit division (the quotient's halves one at a time) */
+static uint64_t div_u64(uint64_t n, uint32_t d, uint32_t *rem)
+{
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t q_hi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t q_lo;
+
+    __asm__("divl %4" : "=a"(q_lo), "=d"(r) : "a"((uint32_t)n), "d"(r), "rm"(d));
+    if (rem)
+        *rem = r;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+void pit_delay_us(uint32_t us)
+{
+    uint32_t count = us * (PIT_HZ / 1000) / 1000;
+    if (count == 0)
+    {
+        count = 1;
+    }
+
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01); /* gate on, speaker off */
+    outb(0x43, 0xB0);                       /* channel 2, lo/hi, mode 0 */
+    outb(0x42, count & 0xFF);
+    outb(0x42, (count >> 8) & 0xFF);
+    while (!(inb(0x61) & 0x20))
+    {
+        cpu_relax();
+    }
+}
+
+/*
+ * The BIOS leaves the 8259s on vectors 0x08-0x0F, on top of the CPU
+ * exceptions. Move them out of the way and mask every line: all our
+ * interrupts come from the local APIC.
+ */
+static void pic_disable(void)
+{
+    outb(PIC1_CMD, 0x11); /* ICW1: init, ICW4 follows */
+    outb(PIC2_CMD, 0x11);
+    outb(PIC1_DATA, PIC1_VECTOR);
+    outb(PIC2_DATA, PIC2_VECTOR);
+    outb(PIC1_DATA, 0x04); /* slave on IRQ2 */
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01); /* 8086 mode */
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
+/* ---------------- Clock ----------------------------------------------- */
+
+static uint64_t tsc_to_ns(uint64_t cycles)
+{
+    uint32_t rem;
+    uint64_t ms = div_u64(cycles, tsc_khz, &rem);
+    /* rem < tsc_khz, so rem * 10^6 stays well inside 64 bits */
+    return ms * NS_PER_MS + div_u64((uint64_t)rem * NS_PER_MS, tsc_khz, NULL);
+}
+
+static uint64_t ns_to_tsc(uint64_t ns)
+{
+    uint32_t rem;
+    uint64_t ms = div_u64(ns, NS_PER_MS, &rem);
+    return ms * tsc_khz + div_u64((uint64_t)rem * tsc_khz, NS_PER_MS, NULL);
+}
+
+uint64_t clock_ns(void)
+{
+    if (tsc_khz == 0)
+        return 0;
+    return tsc_to_ns(rdtsc() - boot_tsc);
+}
+
+uint32_t timer_tsc_khz(void)
+{
+    return tsc_khz;
+}
+
+uint32_t timer_tsc_to_ms(uint64_t cycles)
+{
+    return tsc_khz ? (uint32_t)div_u64(cycles, tsc_khz, NULL) : 0;
+}
+
+uint64_t timer_tsc_to_ns(uint64_t cycles)
+{
+    return tsc_khz ? tsc_to_ns(cycles) : 0;
+}
+
+uint32_t timer_ns_to_ms(uint64_t ns)
+{
+    return (uint32_t)div_u64(ns, NS_PER_MS, NULL);
+}
+
+/* ---------------- One-shot events ------------------------------------- */
+
+/* Fire once at clock_ns() time 'deadline', or never if it is 0 */
+static void arm(uint64_t deadline)
+{
+    if (use_tsc_deadline)
+    {
+        /* Writing 0 disarms; a past deadline fires at once */
+        wrmsr(MSR_TSC_DEADLINE, deadline ? boot_tsc + ns_to_tsc(deadline) : 0);
+        return;
+    }
+
+    uint32_t count = 0;
+    if (deadline)
+    {
+        uint64_t now = clock_ns();
+        uint64_t counts = deadline > now ? div_u64((deadline - now) * lapic_per_ms, NS_PER_MS, NULL) : 0;
+        count = counts == 0 ? 1 : counts > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)counts;
+    }
+    lapic_write(LAPIC_TIMER_INIT, count); /* 0 stops the countdown */
+}
+
+/* Earliest of the idle deadline and the next profiler sample (IF clear) */
+static void program_next(timer_cpu_t *self)
+{
+    uint64_t deadline = self->wake_ns;
+
+    if (prof_active())
+    {
+        uint64_t sample = clock_ns() + 1000000000u / PROF_HZ;
+        if (deadline == 0 || sample < deadline)
+            deadline = sample;
+    }
+    arm(deadline);
+}
+
+static void timer_fire(isr_frame_t *frame)
+{
+    timer_cpu_t *self = &timer_cpus[smp_cpu_id()];
+
+    self->interrupts++;
+    prof_sample(frame);
+
+    if (self->wake_ns && clock_ns() >= self->wake_ns)
+        self->wake_ns = 0; /* the halted CPU is awake now */
+    program_next(self);
+    lapic_eoi();
+}
+
+/* Wake-up IPI: returning from it ends the hlt; also picks up profiler changes */
+static void kick(isr_frame_t *frame)
+{
+    (void)frame;
+    program_next(&timer_cpus[smp_cpu_id()]);
+    lapic_eoi();
+}
+
+/* Spurious APIC interrupts must not be acknowledged */
+static void spurious(isr_frame_t *frame)
+{
+    (void)frame;
+}
+
+static void set_timer_mode(void)
+{
+    if (use_tsc_deadline)
+    {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+    }
+    else
+    {
+        lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR); /* one-shot */
+    }
+}
+
+int timer_init(void)
+{
+    pic_disable();
+    idt_set_irq_gate(LAPIC_TIMER_VECTOR, isr64);
+    idt_set_irq_gate(LAPIC_KICK_VECTOR, isr65);
+    idt_set_irq_gate(LAPIC_SPURIOUS_VECTOR, isr255);
+    idt_set_handler(LAPIC_TIMER_VECTOR, timer_fire);
+    idt_set_handler(LAPIC_KICK_VECTOR, kick);
+    idt_set_handler(LAPIC_SPURIOUS_VECTOR, spurious);
+
+    int have_lapic = lapic_init() == 0;
+    if (have_lapic)
+    {
+        /* Count down from the top, masked, across a known PIT interval */
+        lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+        lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFFu);
+    }
+    uint64_t t0 = rdtsc();
+    pit_delay_us(CALIBRATE_US);
+    uint64_t t1 = rdtsc();
+
+    /* Under 2^32 cycles in 10 ms for any clock below 400 GHz */
+    tsc_khz = (uint32_t)(t1 - t0) / (CALIBRATE_US / 1000);
+    boot_tsc = t1;
+
+    if (!have_lapic)
+    {
+        serial_puts("[TIMER] No local APIC, clock only (no timer interrupts)\n");
+        return -1;
+    }
+    uint32_t elapsed = 0xFFFFFFFFu - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    lapic_per_ms = elapsed / (CALIBRATE_US / 1000);
+
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    use_tsc_deadline = (c & CPUID_ECX_TSC_DEADLINE) != 0;
+    set_timer_mode();
+
+    serial_puts("[TIMER] TSC ");
+    serial_put_dec(tsc_khz / 1000);
+    serial_puts(" MHz, APIC bus ");
+    serial_put_dec(lapic_per_ms * 16 / 1000);
+    serial_puts(" MHz, ");
+    serial_puts(use_tsc_deadline ? "TSC-deadline" : "one-shot APIC");
+    serial_puts(" timer, tickless\n");
+    return 0;
+}
+
+void timer_init_cpu(void)
+{
+    if (lapic_per_ms != 0)
+    {
+        set_timer_mode();
+    }
+}
+
+int timer_available(void)
+{
+    return lapic_per_ms != 0;
+}
+
+void timer_reprogram(void)
+{
+    if (!timer_available())
+        return;
+
+    cpu_irq_disable();
+    program_next(&timer_cpus[smp_cpu_id()]);
+    cpu_irq_enable();
+}
+
+void timer_idle(uint64_t wake_ns)
+{
+    if (!timer_available())
+    {
+        /* Nothing could wake a halted CPU: poll instead */
+        cpu_irq_enable();
+        cpu_relax();
+        return;
+    }
+
+    timer_cpu_t *self = &timer_cpus[smp_cpu_id()];
+    self->wake_ns = wake_ns;
+    program_next(self);
+
+    uint64_t t0 = rdtsc();
+    __asm__ volatile("sti; hlt" ::: "memory"); /* sti holds interrupts off until hlt */
+    self->idle_tsc += rdtsc() - t0;
+    self->wake_ns = 0;
+}
+
+uint32_t timer_interrupts(void)
+{
+    return timer_cpus[smp_cpu_id()].interrupts;
+}
+
+uint64_t timer_idle_ns(int cpu)
+{
+    if (cpu < 0 || cpu >= MAX_CPUS || tsc_khz == 0)
+        return 0;
+    return tsc_to_ns(timer_cpus[cpu].idle_tsc);
+}
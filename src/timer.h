@@ -0,0 +1,58 @@
+/* timer.h - Monotonic clock, one-shot local APIC timer and tickless idle */
+#ifndef KACCHI_TIMER_H
+#define KACCHI_TIMER_H
+
+#include "types.h"
+
+#define NS_PER_MS 1000000u
+
+/*
+ * Mask the legacy 8259 PICs, calibrate the TSC (and the local APIC
+ * timer) against the PIT, and start the clock. -1 if there is no local
+ * APIC: the clock still works, but no timer interrupt can be armed.
+ */
+int timer_init(void);
+
+/* Put an AP's APIC timer in the mode timer_init() picked */
+void timer_init_cpu(void);
+
+/* Timer interrupts can be armed (one-shot APIC or TSC-deadline) */
+int timer_available(void);
+
+/* Nanoseconds since timer_init(); monotonic, TSC resolution */
+uint64_t clock_ns(void);
+
+/* rdtsc() increments per millisecond, as measured by timer_init() */
+uint32_t timer_tsc_khz(void);
+
+/* TSC cycles to milliseconds */
+uint32_t timer_tsc_to_ms(uint64_t cycles);
+
+/* TSC cycles to nanoseconds */
+uint64_t timer_tsc_to_ns(uint64_t cycles);
+
+/* Nanoseconds to milliseconds (no 64-bit division in a freestanding build) */
+uint32_t timer_ns_to_ms(uint64_t ns);
+
+/*
+ * Halt the calling CPU until any interrupt arrives, arming the timer
+ * for 'wake_ns' (a clock_ns() time, 0 for none) first. There is no
+ * periodic tick: only this deadline and profiler samples are ever
+ * programmed. Call with interrupts disabled, after the last check for
+ * work, so a wake-up IPI cannot slip in before the hlt.
+ */
+void timer_idle(uint64_t wake_ns);
+
+/* Re-arm the calling CPU's timer for its next event (profiler started/stopped) */
+void timer_reprogram(void);
+
+/* Timer interrupts taken by the calling CPU */
+uint32_t timer_interrupts(void);
+
+/* Time 'cpu' has spent halted in timer_idle() */
+uint64_t timer_idle_ns(int cpu);
+
+/* Busy-wait on PIT channel 2 (one-shot); good for up to ~54 ms */
+void pit_delay_us(uint32_t us);
+
+#endif /* KACCHI_TIMER_H */
@@ -0,0 +1,80 @@
+/* trace.c - Binary scheduler event trace, one ring per CPU */
+#include "trace.h"
+#include "cpu.h"
+#include "serial.h"
+#include "smp.h"
+#include "timer.h"
+
+typedef struct
+{
+    trace_event_t events[TRACE_EVENTS_PER_CPU];
+    uint32_t written; /* events ever recorded; the ring holds the last ones */
+} trace_ring_t;
+
+static trace_ring_t rings[MAX_CPUS];
+
+void trace_event(trace_type_t type, int32_t pid, uint32_t arg)
+{
+    int cpu = smp_cpu_id();
+    trace_ring_t *ring = &rings[cpu];
+    trace_event_t *ev = &ring->events[ring->written & (TRACE_EVENTS_PER_CPU - 1)];
+
+    ev->tsc = rdtsc();
+    ev->type = (uint8_t)type;
+    ev->cpu = (uint8_t)cpu;
+    ev->pid = (int16_t)pid;
+    ev->arg = arg;
+    ring->written++;
+}
+
+void trace_clear(void)
+{
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+        rings[cpu].written = 0;
+}
+
+static uint32_t ring_held(const trace_ring_t *ring)
+{
+    return ring->written < TRACE_EVENTS_PER_CPU ? ring->written : TRACE_EVENTS_PER_CPU;
+}
+
+uint32_t trace_count(void)
+{
+    uint32_t total = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+        total += ring_held(&rings[cpu]);
+    return total;
+}
+
+size_t trace_write(void)
+{
+    uint32_t header[3] = {TRACE_MAGIC, timer_tsc_khz(), 0};
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (smp_cpu_online(cpu))
+            header[2]++;
+    }
+    serial_write(header, sizeof(header));
+    size_t bytes = sizeof(header);
+
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (!smp_cpu_online(cpu))
+            continue;
+
+        const trace_ring_t *ring = &rings[cpu];
+        uint32_t n = ring_held(ring);
+        uint32_t first = ring->written - n;
+        uint32_t rec[2] = {(uint32_t)cpu, n};
+        serial_write(rec, sizeof(rec));
+
+        /* Oldest first: the tail of the array, then its head if it wrapped */
+        uint32_t start = first & (TRACE_EVENTS_PER_CPU - 1);
+        uint32_t run = TRACE_EVENTS_PER_CPU - start < n ? TRACE_EVENTS_PER_CPU - start : n;
+        serial_write(&ring->events[start], run * sizeof(trace_event_t));
+        serial_write(&ring->events[0], (n - run) * sizeof(trace_event_t));
+
+        bytes += sizeof(rec) + n * sizeof(trace_event_t);
+    }
+    return bytes;
+}
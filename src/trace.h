@@ -0,0 +1,58 @@
+/* trace.h - Binary scheduler event trace, one ring per CPU */
+#ifndef KACCHI_TRACE_H
+#define KACCHI_TRACE_H
+
+#include "types.h"
+
+#define TRACE_EVENTS_PER_CPU 2048 /* power of two */
+#define TRACE_MAGIC 0x43525454u   /* "TTRC" */
+
+/* Event types; 'arg' meaning in brackets */
+typedef enum
+{
+    TRACE_DISPATCH = 1, /* process starts running on this CPU [0] */
+    TRACE_YIELD,        /* gives the CPU up, still READY [0] */
+    TRACE_BLOCK,        /* gives the CPU up, BLOCKED [0] */
+    TRACE_WAKE,         /* BLOCKED/SLEEPING -> READY [waker PID, -1 for kernel] */
+    TRACE_CREATE,       /* new process [parent PID, -1 for kernel] */
+    TRACE_EXIT,         /* process reaped [0] */
+    TRACE_SEND,         /* message posted [destination PID] */
+    TRACE_RECV,         /* mailbox read [1 if a message was taken] */
+    TRACE_ALLOC_FAIL,   /* heap allocation failed [requested bytes] */
+    TRACE_SLEEP         /* gives the CPU up, SLEEPING until a deadline [0] */
+} trace_type_t;
+
+typedef struct
+{
+    uint64_t tsc;
+    uint8_t type; /* trace_type_t */
+    uint8_t cpu;
+    int16_t pid;  /* subject of the event, -1 for kernel */
+    uint32_t arg;
+} trace_event_t;
+
+/*
+ * Record an event in the calling CPU's ring: an rdtsc and four stores,
+ * no locks. Only this CPU writes its ring, and the timer interrupt
+ * never traces, so there is nothing to race with. Oldest events are
+ * overwritten once a ring is full.
+ */
+void trace_event(trace_type_t type, int32_t pid, uint32_t arg);
+
+/* Forget everything recorded so far */
+void trace_clear(void);
+
+/* Events currently held, all CPUs */
+uint32_t trace_count(void);
+
+/*
+ * Stream the rings over serial for tools/trace2json.py as a compact
+ * little-endian record:
+ *   u32 magic, u32 tsc_khz, u32 cpu_count,
+ *   then per CPU: u32 cpu, u32 n, n events oldest first
+ *   (u64 tsc, u8 type, u8 cpu, i16 pid, u32 arg).
+ * Returns the number of bytes written.
+ */
+size_t trace_write(void);
+
+#endif /* KACCHI_TRACE_H */
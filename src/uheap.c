@@ -0,0 +1,114 @@
+/* uheap.c - Per-process heap in the process's own address space */
+#include "uheap.h"
+#include "paging.h"
+
+#define UHEAP_UNITS (UHEAP_SIZE / UHEAP_UNIT)
+
+void uheap_init(uheap_t *uh)
+{
+    uh->count = 0;
+    uh->committed = 0;
+    uh->bump = uh->limit = 0;
+}
+
+/* Back [UHEAP_BASE, UHEAP_BASE + end) with zeroed user frames */
+static int commit(uheap_t *uh, uint32_t *dir, uint32_t end)
+{
+    while (uh->committed < end)
+    {
+        uint32_t frame = frame_alloc();
+        if (frame == 0)
+            return -1;
+        if (paging_map(dir, UHEAP_BASE + uh->committed, frame, PTE_USER | PTE_WRITE) != 0)
+        {
+            frame_free(frame);
+            return -1;
+        }
+        uh->committed += PAGE_SIZE;
+    }
+    return 0;
+}
+
+void *uheap_alloc(uheap_t *uh, uint32_t *dir, size_t size)
+{
+    if (size == 0 || size > UHEAP_SIZE || uh->count == UHEAP_MAX_BLOCKS)
+        return NULL;
+    uint32_t units = (size + UHEAP_UNIT - 1) / UHEAP_UNIT;
+
+    /* First gap that fits: before block i, or after the last one */
+    uint32_t start = 0;
+    uint32_t i = 0;
+    for (; i < uh->count; i++)
+    {
+        if (uh->blocks[i].start - start >= units)
+            break;
+        start = uh->blocks[i].start + uh->blocks[i].units;
+    }
+    if (UHEAP_UNITS - start < units)
+        return NULL;
+
+    if (commit(uh, dir, (start + units) * UHEAP_UNIT) != 0)
+        return NULL;
+
+    for (uint32_t j = uh->count; j > i; j--)
+        uh->blocks[j] = uh->blocks[j - 1];
+    uh->blocks[i].start = (uint16_t)start;
+    uh->blocks[i].units = (uint16_t)units;
+    uh->count++;
+    return (void *)(UHEAP_BASE + start * UHEAP_UNIT);
+}
+
+/* Only the table is trusted; freeing an arena chunk just hurts the caller's own data */
+int uheap_free(uheap_t *uh, void *ptr)
+{
+    uint32_t va = (uint32_t)ptr;
+    if (va < UHEAP_BASE || va - UHEAP_BASE >= UHEAP_SIZE || (va - UHEAP_BASE) % UHEAP_UNIT)
+        return -1;
+    uint32_t start = (va - UHEAP_BASE) / UHEAP_UNIT;
+
+    for (uint32_t i = 0; i < uh->count; i++)
+    {
+        if (uh->blocks[i].start != start)
+            continue;
+        uh->count--;
+        for (; i < uh->count; i++)
+            uh->blocks[i] = uh->blocks[i + 1];
+        return 0;
+    }
+    return -1;
+}
+
+uint32_t uheap_live_bytes(const uheap_t *uh)
+{
+    uint32_t units = 0;
+    for (uint32_t i = 0; i < uh->count; i++)
+        units += uh->blocks[i].units;
+    return units * UHEAP_UNIT;
+}
+
+void *uheap_arena_alloc(uheap_t *uh, uint32_t *dir, size_t size)
+{
+    if (size == 0)
+        return NULL;
+    size = (size + 3u) & ~3u;
+
+    /* Fast path: fits in the current chunk */
+    if (uh->limit - uh->bump >= size)
+    {
+        void *out = (void *)uh->bump;
+        uh->bump += size;
+        return out;
+    }
+
+    /* Oversized requests get a chunk of their own and keep the current one */
+    uint32_t chunk = size < UHEAP_ARENA_CHUNK ? UHEAP_ARENA_CHUNK : size;
+    uint8_t *payload = uheap_alloc(uh, dir, chunk);
+    if (payload == NULL)
+        return NULL;
+    if (chunk - size >= uh->limit - uh->bump)
+    {
+        uh->bump = (uint32_t)payload + size;
+        uh->limit = (uint32_t)payload + chunk;
+    }
+    return payload;
+}
@@ -0,0 +1,55 @@
+/* uheap.h - Per-process heap in the process's own address space */
+#ifndef KACCHI_UHEAP_H
+#define KACCHI_UHEAP_H
+
+#include "types.h"
+
+/*
+ * Every space reserves the same window above the ramfs one for its
+ * heap. Pages are committed as blocks first reach them and go back
+ * with the address space.
+ */
+#define UHEAP_BASE 0x80000000u
+#define UHEAP_SIZE (512u * 1024)
+#define UHEAP_UNIT 16u       /* allocation granularity and alignment */
+#define UHEAP_MAX_BLOCKS 64  /* live blocks per process, arena chunks included */
+#define UHEAP_ARENA_CHUNK 256u
+
+/*
+ * Allocator state, kept in the PCB: ring 3 can write every byte of
+ * its heap, so nothing the kernel trusts lives there. Blocks are
+ * [start, start + units) in UHEAP_UNIT steps from UHEAP_BASE, sorted
+ * by start; the gaps between them are the free space.
+ */
+typedef struct
+{
+    uint16_t start;
+    uint16_t units;
+} uheap_block_t;
+
+typedef struct
+{
+    uheap_block_t blocks[UHEAP_MAX_BLOCKS];
+    uint32_t count;
+    uint32_t committed;   /* bytes from UHEAP_BASE backed by frames */
+    uint32_t bump, limit; /* arena: next free byte and end of the current chunk */
+} uheap_t;
+
+void uheap_init(uheap_t *uh);
+
+/* First-fit block of 'size' bytes mapped in 'dir'; NULL if none fits */
+void *uheap_alloc(uheap_t *uh, uint32_t *dir, size_t size);
+
+/* Free the block starting at 'ptr'; -1 if no live block starts there */
+int uheap_free(uheap_t *uh, void *ptr);
+
+/* Bytes in live blocks, rounded up to UHEAP_UNIT each */
+uint32_t uheap_live_bytes(const uheap_t *uh);
+
+/*
+ * Bump-allocate 'size' bytes (4-byte aligned) from arena chunks that
+ * are never freed individually: the whole arena goes with the space.
+ */
+void *uheap_arena_alloc(uheap_t *uh, uint32_t *dir, size_t size);
+
+#endif /* KACCHI_UHEAP_H */
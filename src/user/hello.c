@@ -0,0 +1,23 @@
+/* hello.c - Sample ELF program for proc_exec, loaded as a boot module */
+#include "usys.h"
+
+/* Writable, so private to each instance: every copy counts from 1 */
+static uint32_t runs = 0;
+static char scratch[64];
+
+/* Entry point (see user.ld); returning exits like any process body */
+void main(void)
+{
+    runs++;
+    scratch[0] = 'o';
+    scratch[1] = 'k';
+    scratch[2] = '\0';
+
+    sys_puts("    [hello.elf] PID ");
+    sys_put_dec((uint32_t)sys_getpid());
+    sys_puts(", run ");
+    sys_put_dec(runs);
+    sys_puts(": ");
+    sys_puts(scratch);
+    sys_puts("\n");
+}
@@ -0,0 +1,206 @@
+/* usys.h - System call stubs for ring-3 process code */
+#ifndef KACCHI_USYS_H
+#define KACCHI_USYS_H
+
+#include "types.h"
+#include "syscall.h"
+#include "waitset.h"
+
+/*
+ * Fast path: SYSENTER. SYSEXIT resumes at ECX/EDX, so we hand the
+ * kernel our ESP and the address just past the instruction.
+ */
+static inline uint32_t usys_call(uint32_t nr, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    uint32_t ret;
+    __asm__ volatile(
+        "mov %%esp, %%ecx\n\t"
+        "lea 1f, %%edx\n\t"
+        "sysenter\n"
+        "1:"
+        : "=a"(ret)
+        : "a"(nr), "b"(a0), "S"(a1), "D"(a2)
+        : "ecx", "edx", "memory", "cc");
+    return ret;
+}
+
+/* Fallback path: a software interrupt through the DPL 3 gate */
+static inline uint32_t usys_call_int80(uint32_t nr, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    uint32_t ret;
+    __asm__ volatile("int $0x80"
+                     : "=a"(ret)
+                     : "a"(nr), "b"(a0), "S"(a1), "D"(a2)
+                     : "memory", "cc");
+    return ret;
+}
+
+static inline void sys_exit(void)
+{
+    usys_call(SYS_EXIT, 0, 0, 0);
+}
+
+static inline void sys_yield(void)
+{
+    usys_call(SYS_YIELD, 0, 0, 0);
+}
+
+static inline int32_t sys_getpid(void)
+{
+    return (int32_t)usys_call(SYS_GETPID, 0, 0, 0);
+}
+
+static inline void sys_puts(const char *s)
+{
+    usys_call(SYS_PUTS, (uint32_t)s, 0, 0);
+}
+
+static inline void sys_put_dec(uint32_t value)
+{
+    usys_call(SYS_PUT_DEC, value, 0, 0);
+}
+
+static inline void *sys_heap_alloc(size_t size)
+{
+    return (void *)usys_call(SYS_HEAP_ALLOC, size, 0, 0);
+}
+
+static inline int sys_heap_free(void *ptr)
+{
+    return (int)usys_call(SYS_HEAP_FREE, (uint32_t)ptr, 0, 0);
+}
+
+static inline void *sys_proc_alloc(size_t size)
+{
+    return (void *)usys_call(SYS_PROC_ALLOC, size, 0, 0);
+}
+
+static inline int sys_send(int32_t pid, const char *msg)
+{
+    return (int)usys_call(SYS_SEND, (uint32_t)pid, (uint32_t)msg, 0);
+}
+
+static inline int sys_recv(char *out)
+{
+    return (int)usys_call(SYS_RECV, (uint32_t)out, 0, 0);
+}
+
+static inline int32_t sys_fork(void)
+{
+    return (int32_t)usys_call(SYS_FORK, 0, 0, 0);
+}
+
+static inline uint32_t sys_null(void)
+{
+    return usys_call(SYS_NULL, 0, 0, 0);
+}
+
+static inline uint32_t sys_null_int80(void)
+{
+    return usys_call_int80(SYS_NULL, 0, 0, 0);
+}
+
+static inline void sys_sleep(uint32_t ms)
+{
+    usys_call(SYS_SLEEP, ms, 0, 0);
+}
+
+static inline uint32_t sys_uptime(void)
+{
+    return usys_call(SYS_UPTIME, 0, 0, 0);
+}
+
+static inline int32_t sys_chan_create(void)
+{
+    return (int32_t)usys_call(SYS_CHAN_CREATE, 0, 0, 0);
+}
+
+static inline int sys_chan_send(int32_t id, const char *msg)
+{
+    return (int)usys_call(SYS_CHAN_SEND, (uint32_t)id, (uint32_t)msg, 0);
+}
+
+static inline int sys_chan_recv(int32_t id, char *out)
+{
+    return (int)usys_call(SYS_CHAN_RECV, (uint32_t)id, (uint32_t)out, 0);
+}
+
+static inline int sys_ws_add(int type, int32_t id)
+{
+    return (int)usys_call(SYS_WS_ADD, (uint32_t)type, (uint32_t)id, 0);
+}
+
+static inline int sys_ws_remove(int slot)
+{
+    return (int)usys_call(SYS_WS_REMOVE, (uint32_t)slot, 0, 0);
+}
+
+static inline int sys_ws_wait(int32_t *out, int max, uint32_t timeout_ms)
+{
+    return (int)usys_call(SYS_WS_WAIT, (uint32_t)out, (uint32_t)max, timeout_ms);
+}
+
+static inline int sys_edf_set(uint32_t runtime_us, uint32_t period_us, uint32_t deadline_us)
+{
+    return (int)usys_call(SYS_EDF_SET, runtime_us, period_us, deadline_us);
+}
+
+static inline int sys_edf_wait(void)
+{
+    return (int)usys_call(SYS_EDF_WAIT, 0, 0, 0);
+}
+
+static inline int sys_fs_open(const char *name)
+{
+    return (int)usys_call(SYS_FS_OPEN, (uint32_t)name, 0, 0);
+}
+
+static inline uint32_t sys_fs_size(int fd)
+{
+    return usys_call(SYS_FS_SIZE, (uint32_t)fd, 0, 0);
+}
+
+static inline const void *sys_fs_map(int fd)
+{
+    return (const void *)usys_call(SYS_FS_MAP, (uint32_t)fd, 0, 0);
+}
+
+static inline int sys_futex_wait(volatile uint32_t *addr, uint32_t expected)
+{
+    return (int)usys_call(SYS_FUTEX_WAIT, (uint32_t)addr, expected, 0);
+}
+
+static inline int sys_futex_wake(volatile uint32_t *addr, uint32_t count)
+{
+    return (int)usys_call(SYS_FUTEX_WAKE, (uint32_t)addr, count, 0);
+}
+
+/*
+ * Mutex in memory shared between processes, same protocol as the
+ * kernel's mutex_t: 0 free, 1 held, 2 held with waiters. The kernel is
+ * entered only when it is contended.
+ */
+static inline void umutex_lock(volatile uint32_t *m)
+{
+    uint32_t c = 0;
+    if (__atomic_compare_exchange_n(m, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+    if (c != 2)
+        c = __atomic_exchange_n(m, 2, __ATOMIC_ACQUIRE);
+    while (c != 0)
+    {
+        sys_futex_wait(m, 2);
+        c = __atomic_exchange_n(m, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+static inline void umutex_unlock(volatile uint32_t *m)
+{
+    if (__atomic_fetch_sub(m, 1, __ATOMIC_RELEASE) != 1)
+    {
+        __atomic_store_n(m, 0, __ATOMIC_RELEASE);
+        sys_futex_wake(m, 1);
+    }
+}
+
+#endif /* KACCHI_USYS_H */
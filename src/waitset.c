@@ -0,0 +1,250 @@
+/* waitset.c - Wait on many mailboxes, channels and timers at once */
+#include "waitset.h"
+#include "chan.h"
+#include "process.h"
+#include "scheduler.h"
+#include "spinlock.h"
+#include "timer.h"
+
+#define WATCH_WORDS (MAX_PROCS / 32)
+
+typedef struct
+{
+    int type;          /* WS_*, 0 if the slot is free */
+    int32_t id;        /* PID or channel */
+    uint32_t period_ms; /* WS_TIMER */
+    uint64_t due_ns;    /* WS_TIMER: next expiry on clock_ns() */
+} ws_source_t;
+
+typedef struct
+{
+    spinlock_t lock;
+    uint32_t ready; /* slots with an edge not reported yet */
+    int waiting;    /* the owner is (about to be) asleep in waitset_wait() */
+    ws_source_t src[WAITSET_MAX];
+} waitset_t;
+
+/* One per process, indexed by PID */
+static waitset_t waitsets[MAX_PROCS];
+
+/* Which wait sets (bit = owner PID) watch each mailbox and channel */
+static volatile uint32_t mailbox_watch[MAX_PROCS][WATCH_WORDS];
+static volatile uint32_t chan_watch[CHAN_MAX][WATCH_WORDS];
+
+static volatile uint32_t *watch_bits(int type, int32_t id)
+{
+    if (type == WS_MAILBOX && id >= 0 && id < MAX_PROCS)
+        return mailbox_watch[id];
+    if (type == WS_CHANNEL && id >= 0 && id < CHAN_MAX)
+        return chan_watch[id];
+    return NULL;
+}
+
+/* A source is level-ready when added: seed its edge so nothing already queued is missed */
+static int source_pending(int type, int32_t id)
+{
+    if (type == WS_MAILBOX)
+    {
+        pcb_t *pcb = proc_get_pcb(id);
+        return pcb != NULL && pcb->has_msg;
+    }
+    return type == WS_CHANNEL && chan_pending(id) > 0;
+}
+
+/* Stop advertising 'owner' on (type, id) unless another slot still watches it (ws->lock held) */
+static void unwatch(waitset_t *ws, int32_t owner, int type, int32_t id)
+{
+    volatile uint32_t *bits = watch_bits(type, id);
+    if (bits == NULL)
+        return;
+
+    for (int slot = 0; slot < WAITSET_MAX; slot++)
+    {
+        if (ws->src[slot].type == type && ws->src[slot].id == id)
+            return;
+    }
+    __atomic_and_fetch(&bits[owner / 32], ~(1u << (owner % 32)), __ATOMIC_SEQ_CST);
+}
+
+int waitset_add(int type, int32_t id)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0)
+        return -1;
+    if (type == WS_TIMER ? id <= 0 : watch_bits(type, id) == NULL)
+        return -1;
+
+    waitset_t *ws = &waitsets[pid];
+    spin_lock(&ws->lock);
+    int slot = 0;
+    while (slot < WAITSET_MAX && ws->src[slot].type != 0)
+        slot++;
+    if (slot == WAITSET_MAX)
+    {
+        spin_unlock(&ws->lock);
+        return -1;
+    }
+
+    ws_source_t *src = &ws->src[slot];
+    src->type = type;
+    src->id = id;
+    if (type == WS_TIMER)
+    {
+        src->period_ms = (uint32_t)id;
+        src->due_ns = clock_ns() + (uint64_t)src->period_ms * NS_PER_MS;
+    }
+    else
+    {
+        /* Publish the watch before looking: a later send then notifies us */
+        volatile uint32_t *bits = watch_bits(type, id);
+        __atomic_or_fetch(&bits[pid / 32], 1u << (pid % 32), __ATOMIC_SEQ_CST);
+        if (source_pending(type, id))
+            ws->ready |= 1u << slot;
+    }
+    spin_unlock(&ws->lock);
+    return slot;
+}
+
+int waitset_remove(int slot)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0 || slot < 0 || slot >= WAITSET_MAX)
+        return -1;
+
+    waitset_t *ws = &waitsets[pid];
+    spin_lock(&ws->lock);
+    ws_source_t *src = &ws->src[slot];
+    if (src->type == 0)
+    {
+        spin_unlock(&ws->lock);
+        return -1;
+    }
+    int type = src->type;
+    src->type = 0;
+    ws->ready &= ~(1u << slot);
+    unwatch(ws, pid, type, src->id);
+    spin_unlock(&ws->lock);
+    return 0;
+}
+
+int waitset_wait(int32_t *out, int max, uint32_t timeout_ms)
+{
+    int32_t pid = scheduler_current_pid();
+    if (pid < 0 || max <= 0)
+        return -1;
+
+    waitset_t *ws = &waitsets[pid];
+    uint64_t timeout_at = timeout_ms == WS_FOREVER ? 0 : clock_ns() + (uint64_t)timeout_ms * NS_PER_MS;
+    int32_t got[WAITSET_MAX];
+    int n = 0;
+
+    while (1)
+    {
+        spin_lock(&ws->lock);
+        ws->waiting = 0;
+
+        /* Timers are the only sources checked here, and only against their own deadline */
+        uint64_t now = clock_ns();
+        uint64_t wake = timeout_at;
+        for (int slot = 0; slot < WAITSET_MAX; slot++)
+        {
+            ws_source_t *src = &ws->src[slot];
+            if (src->type != WS_TIMER)
+                continue;
+            if (now >= src->due_ns)
+            {
+                ws->ready |= 1u << slot;
+                src->due_ns += (uint64_t)src->period_ms * NS_PER_MS;
+                if (src->due_ns <= now) /* missed whole periods: report once */
+                    src->due_ns = now + (uint64_t)src->period_ms * NS_PER_MS;
+            }
+            if (wake == 0 || src->due_ns < wake)
+                wake = src->due_ns;
+        }
+
+        if (ws->ready || (timeout_at && now >= timeout_at))
+            break;
+
+        /* A notifier seeing 'waiting' wakes us; it takes ws->lock first, so no edge is lost */
+        ws->waiting = 1;
+        if (wake)
+            scheduler_sleep_until_unlock(wake, &ws->lock);
+        else
+            scheduler_block_unlock(&ws->lock);
+    }
+
+    for (int slot = 0; slot < WAITSET_MAX && n < max; slot++)
+    {
+        if (ws->ready & (1u << slot))
+        {
+            ws->ready &= ~(1u << slot);
+            got[n++] = slot;
+        }
+    }
+    spin_unlock(&ws->lock);
+
+    /* Copy out after unlocking; 'out' may take a copy-on-write fault */
+    for (int i = 0; i < n; i++)
+        out[i] = got[i];
+    return n;
+}
+
+/* Mark owner's slots on (type, id) ready, waking it if it waits (takes its ws->lock) */
+static void notify_owner(int32_t owner, int type, int32_t id)
+{
+    waitset_t *ws = &waitsets[owner];
+
+    spin_lock(&ws->lock);
+    for (int slot = 0; slot < WAITSET_MAX; slot++)
+    {
+        if (ws->src[slot].type == type && ws->src[slot].id == id)
+            ws->ready |= 1u << slot;
+    }
+    if (ws->ready && ws->waiting)
+    {
+        ws->waiting = 0;
+        proc_wake(owner); /* fails harmlessly if its timer already woke it */
+    }
+    spin_unlock(&ws->lock);
+}
+
+void waitset_notify(int type, int32_t id)
+{
+    volatile uint32_t *bits = watch_bits(type, id);
+    if (bits == NULL)
+        return;
+
+    /* Pairs with waitset_add(): the message is visible before we look for watchers */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int w = 0; w < WATCH_WORDS; w++)
+    {
+        uint32_t mask = bits[w];
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            mask &= mask - 1;
+            notify_owner(w * 32 + bit, type, id);
+        }
+    }
+}
+
+void waitset_release(int32_t pid)
+{
+    if (pid < 0 || pid >= MAX_PROCS)
+        return;
+
+    waitset_t *ws = &waitsets[pid];
+    spin_lock(&ws->lock);
+    for (int slot = 0; slot < WAITSET_MAX; slot++)
+    {
+        ws_source_t *src = &ws->src[slot];
+        if (src->type == 0)
+            continue;
+        int type = src->type;
+        src->type = 0;
+        unwatch(ws, pid, type, src->id);
+    }
+    ws->ready = 0;
+    ws->waiting = 0;
+    spin_unlock(&ws->lock);
+}
@@ -0,0 +1,41 @@
+/* waitset.h - Wait on many mailboxes, channels and timers at once */
+#ifndef KACCHI_WAITSET_H
+#define KACCHI_WAITSET_H
+
+#include "types.h"
+
+/* Sources a wait set can watch (also the SYS_WS_ADD ABI) */
+#define WS_MAILBOX 1 /* id: PID whose mailbox gets a message */
+#define WS_CHANNEL 2 /* id: channel that gets a message */
+#define WS_TIMER 3   /* id: period in ms, first due one period after adding */
+
+#define WAITSET_MAX 16         /* sources per process */
+#define WS_FOREVER 0xFFFFFFFFu /* waitset_wait() timeout: none */
+
+/*
+ * Every process has one wait set. Readiness is edge-triggered: a send
+ * marks the watching slots ready and wakes the owner if it is waiting,
+ * and waitset_wait() reports each slot once per edge, so the caller
+ * drains the source before waiting again. Nothing rescans the sources.
+ */
+
+/* Watch a source; returns its slot, -1 if the set is full or the source is invalid */
+int waitset_add(int type, int32_t id);
+
+/* Stop watching 'slot'; -1 if it is not in use */
+int waitset_remove(int slot);
+
+/*
+ * Block until at least one slot is ready or 'timeout_ms' passes (0
+ * polls, WS_FOREVER never times out), then write up to 'max' ready
+ * slots to 'out' and return how many. 0 means the timeout expired.
+ */
+int waitset_wait(int32_t *out, int max, uint32_t timeout_ms);
+
+/* Edge: a message arrived on (type, id). Cheap when nobody watches it. */
+void waitset_notify(int type, int32_t id);
+
+/* Drop the wait set of an exiting process */
+void waitset_release(int32_t pid);
+
+#endif /* KACCHI_WAITSET_H */
@@ -0,0 +1,120 @@
+/* workq.c - Deferred work drained by a kernel worker process */
+#include "workq.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+
+/* Pending items, newest first; pushed lock-free, taken all at once by the worker */
+static work_t *volatile work_head = NULL;
+
+static int32_t worker_pid = -1;
+
+static volatile uint32_t work_queued = 0;
+static volatile uint32_t work_merged = 0;
+static volatile uint32_t work_passes = 0;
+static volatile uint32_t work_runs = 0;
+
+int work_queue(work_t *work)
+{
+    if (__atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQUIRE))
+    {
+        __atomic_add_fetch(&work_merged, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    /* Only pushes race here: the worker takes the whole list, so there is no ABA */
+    work_t *head = work_head;
+    do
+    {
+        work->next = head;
+    } while (!__atomic_compare_exchange_n(&work_head, &head, work, 1, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+    __atomic_add_fetch(&work_queued, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* Run one batch in queueing order */
+static void run_batch(work_t *batch)
+{
+    work_t *fifo = NULL;
+    while (batch)
+    {
+        work_t *next = batch->next;
+        batch->next = fifo;
+        fifo = batch;
+        batch = next;
+    }
+
+    while (fifo)
+    {
+        work_t *work = fifo;
+        fifo = work->next;
+        /* Cleared first: anything queued from here on needs another run */
+        __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+        work->fn(work);
+        work_runs++;
+    }
+}
+
+/* Kernel-mode process body: drain, then sleep until workq_poll() wakes us */
+static void worker_main(void)
+{
+    while (1)
+    {
+        work_t *batch = __atomic_exchange_n(&work_head, NULL, __ATOMIC_ACQUIRE);
+        if (batch == NULL)
+        {
+            /*
+             * An item queued after the exchange finds us still RUNNING and
+             * the wake-up fails, but workq_poll() repeats it on every
+             * scheduler pass until we are BLOCKED, so it is only late.
+             */
+            scheduler_block();
+            continue;
+        }
+
+        work_passes++;
+        run_batch(batch);
+
+        /* Cooperative: let others run before the next batch */
+        if (work_head != NULL)
+            scheduler_yield();
+    }
+}
+
+void workq_init(void)
+{
+    worker_pid = proc_create_kernel(worker_main);
+    if (worker_pid < 0)
+    {
+        serial_puts("[WORKQ] No worker process, deferred work will not run\n");
+        return;
+    }
+    /* Lowest PID, so the first one a bare 'kill' would hit */
+    proc_set_critical(worker_pid);
+    proc_set_state(worker_pid, PR_BLOCKED);
+}
+
+void workq_poll(void)
+{
+    if (work_head == NULL || worker_pid < 0)
+        return;
+
+    /* Critical, so the PID is still ours */
+    proc_wake(worker_pid);
+}
+
+void workq_print_stats(void)
+{
+    serial_puts("Work queue (worker PID ");
+    serial_put_dec((uint32_t)worker_pid);
+    serial_puts("): ");
+    serial_put_dec(work_queued);
+    serial_puts(" queued, ");
+    serial_put_dec(work_merged);
+    serial_puts(" merged into pending, ");
+    serial_put_dec(work_runs);
+    serial_puts(" run in ");
+    serial_put_dec(work_passes);
+    serial_puts(" passes\n");
+}
@@ -0,0 +1,44 @@
+/* workq.h - Deferred work drained by a kernel worker process */
+#ifndef KACCHI_WORKQ_H
+#define KACCHI_WORKQ_H
+
+#include "types.h"
+
+typedef struct work work_t;
+
+/*
+ * A unit of deferred work, usually a static object owned by the
+ * subsystem that queues it. Queueing an item that is still pending
+ * merges with it: the handler runs once and sees everything that
+ * accumulated, which is how repeated work of one kind is batched.
+ */
+struct work
+{
+    work_t *next;          /* queue link, owned by workq.c while pending */
+    void (*fn)(work_t *);  /* runs on the worker, in process context */
+    volatile int pending;  /* queued and not started yet */
+};
+
+#define WORK_INIT(handler) {NULL, (handler), 0}
+
+/* Start the worker (a kernel-mode process, blocked until there is work) */
+void workq_init(void);
+
+/*
+ * Queue 'work' and return at once: one atomic exchange and a
+ * compare-and-swap, no locks, so interrupt handlers may call it.
+ * Returns 0 if queued, 1 if it was already pending (merged).
+ */
+int work_queue(work_t *work);
+
+/*
+ * Wake the worker if anything is queued. Interrupt context cannot take
+ * the locks a wake-up needs, so every scheduler loop iteration calls
+ * this instead.
+ */
+void workq_poll(void);
+
+/* Items queued, merged into a pending one, and worker passes */
+void workq_print_stats(void);
+
+#endif /* KACCHI_WORKQ_H */
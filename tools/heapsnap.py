@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Decode the binary heap snapshot emitted by kacchiOS `meminfo -b`.
+
+Capture the serial output (e.g. `make run | tee serial.log`), run
+`meminfo -b` in the shell, then:
+
+    tools/heapsnap.py serial.log            # table of segments
+    tools/heapsnap.py serial.log --csv      # offset,length,free for plotting
+"""
+import struct
+import sys
+
+BEGIN = b"--- HEAPSNAP BEGIN ---\r\n"
+END = b"\r\n--- HEAPSNAP END ---"
+MAGIC = 0x314E5348
+
+
+def snapshots(data):
+    pos = 0
+    while True:
+        start = data.find(BEGIN, pos)
+        if start < 0:
+            return
+        start += len(BEGIN)
+        magic, heap_size, count = struct.unpack_from("<IHH", data, start)
+        if magic != MAGIC:
+            raise ValueError("bad snapshot magic at offset %d" % start)
+        body = start + 8
+        segs = []
+        for i in range(count):
+            off, word = struct.unpack_from("<HH", data, body + 4 * i)
+            segs.append((off, word & 0x7FFF, bool(word & 0x8000)))
+        yield heap_size, segs
+        pos = body + 4 * count
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    data = open(sys.argv[1], "rb").read()
+    csv = "--csv" in sys.argv[2:]
+    for n, (heap_size, segs) in enumerate(snapshots(data)):
+        if csv:
+            print("snapshot,offset,length,free")
+            for off, length, free in segs:
+                print("%d,%d,%d,%d" % (n, off, length, int(free)))
+            continue
+        print("snapshot %d: heap %d bytes, %d segments" % (n, heap_size, len(segs)))
+        for off, length, free in segs:
+            print("  %5d  %5d  %s" % (off, length, "free" if free else "used"))
+
+
+if __name__ == "__main__":
+    main()
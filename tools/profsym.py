@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Symbolize the samples emitted by kacchiOS `prof dump`.
+
+Capture the serial output (e.g. `make run | tee serial.log`), run
+`prof start`, the workload, then `prof dump` in the shell, and:
+
+    tools/profsym.py serial.log src/kernel.elf          # flat profile
+    tools/profsym.py serial.log src/kernel.elf --pid    # split by PID
+    tools/profsym.py serial.log src/kernel.elf --raw    # eip,pid,cpu,user
+
+Addresses are resolved against `nm -n kernel.elf` (set NM to override,
+e.g. NM=i686-linux-gnu-nm).
+"""
+import bisect
+import collections
+import os
+import struct
+import subprocess
+import sys
+
+BEGIN = b"--- PROF BEGIN ---\r\n"
+MAGIC = 0x464F5250
+PROF_USER = 0x01
+
+
+def dumps(data):
+    pos = 0
+    while True:
+        start = data.find(BEGIN, pos)
+        if start < 0:
+            return
+        start += len(BEGIN)
+        magic, count, dropped, hz = struct.unpack_from("<IIII", data, start)
+        if magic != MAGIC:
+            raise ValueError("bad profile magic at offset %d" % start)
+        body = start + 16
+        samples = [struct.unpack_from("<IhBB", data, body + 8 * i) for i in range(count)]
+        yield hz, dropped, samples
+        pos = body + 8 * count
+
+
+def load_symbols(elf):
+    nm = os.environ.get("NM", "nm")
+    out = subprocess.run([nm, "-n", elf], check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "tTwW":
+            addrs.append(int(parts[0], 16))
+            names.append(parts[2])
+    return addrs, names
+
+
+def symbolize(addrs, names, eip):
+    i = bisect.bisect_right(addrs, eip) - 1
+    return names[i] if i >= 0 else "0x%08x" % eip
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    data = open(sys.argv[1], "rb").read()
+    addrs, names = load_symbols(sys.argv[2])
+    by_pid = "--pid" in sys.argv[3:]
+    raw = "--raw" in sys.argv[3:]
+
+    for n, (hz, dropped, samples) in enumerate(dumps(data)):
+        if raw:
+            print("dump,eip,pid,cpu,user")
+            for eip, pid, cpu, flags in samples:
+                print("%d,0x%08x,%d,%d,%d" % (n, eip, pid, cpu, flags & PROF_USER))
+            continue
+
+        total = len(samples)
+        print("dump %d: %d samples at %d Hz per CPU, %d dropped" % (n, total, hz, dropped))
+        if total == 0:
+            continue
+        hist = collections.Counter()
+        for eip, pid, cpu, flags in samples:
+            key = symbolize(addrs, names, eip)
+            if flags & PROF_USER:
+                key += " [user]"
+            if by_pid:
+                key = ("pid %-3d " % pid if pid >= 0 else "kernel  ") + key
+            hist[key] += 1
+        for key, hits in hist.most_common():
+            print("  %6.2f%%  %6d  %s" % (100.0 * hits / total, hits, key))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Convert the scheduler trace emitted by kacchiOS `trace` to Chrome
+trace-event JSON (load it in chrome://tracing or ui.perfetto.dev).
+
+Capture the serial output (e.g. `make run | tee serial.log`), run a
+workload and then `trace` in the shell, and:
+
+    tools/trace2json.py serial.log > trace.json
+    tools/trace2json.py serial.log --text        # one line per event
+
+Each CPU is a track showing which process held it. Wake-ups are drawn as
+flow arrows from the waker to the wakee's next dispatch, and every
+dispatch carries the time the process spent READY before it ran.
+"""
+import json
+import struct
+import sys
+
+BEGIN = b"--- TRACE BEGIN ---\r\n"
+MAGIC = 0x43525454
+EVENT = struct.Struct("<QBBhI")
+
+NAMES = {1: "dispatch", 2: "yield", 3: "block", 4: "wake", 5: "create",
+         6: "exit", 7: "send", 8: "recv", 9: "alloc_fail", 10: "sleep"}
+DISPATCH, YIELD, BLOCK, WAKE, CREATE, EXIT, SEND, RECV, ALLOC_FAIL, SLEEP = range(1, 11)
+
+
+def signed(arg):
+    return arg - (1 << 32) if arg & 0x80000000 else arg
+
+
+def traces(data):
+    pos = 0
+    while True:
+        start = data.find(BEGIN, pos)
+        if start < 0:
+            return
+        pos = start + len(BEGIN)
+        magic, tsc_khz, cpus = struct.unpack_from("<III", data, pos)
+        if magic != MAGIC:
+            raise ValueError("bad trace magic at offset %d" % pos)
+        pos += 12
+        events = []
+        for _ in range(cpus):
+            cpu, n = struct.unpack_from("<II", data, pos)
+            pos += 8
+            for i in range(n):
+                events.append(EVENT.unpack_from(data, pos + EVENT.size * i))
+            pos += EVENT.size * n
+        events.sort(key=lambda ev: ev[0])
+        yield tsc_khz, events
+
+
+def to_chrome(tsc_khz, events):
+    if not events:
+        return []
+    base = events[0][0]
+    scale = 1000.0 / max(tsc_khz, 1)  # TSC cycles -> microseconds
+
+    def us(tsc):
+        return (tsc - base) * scale
+
+    out = [{"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "kacchiOS"}}]
+    running = {}   # cpu -> (pid, start_us)
+    ready_at = {}  # pid -> us it last became READY
+    flows = {}     # pid -> flow id waiting for its dispatch
+    next_flow = 1
+
+    for tsc, kind, cpu, pid, arg in events:
+        t = us(tsc)
+        if kind == DISPATCH:
+            args = {}
+            if pid in ready_at:
+                args["ready_wait_us"] = round(t - ready_at.pop(pid), 3)
+            running[cpu] = (pid, t, args)
+            if pid in flows:
+                out.append({"name": "wake", "ph": "f", "bp": "e", "id": flows.pop(pid),
+                            "pid": 0, "tid": cpu, "ts": t})
+        elif kind in (YIELD, BLOCK, SLEEP) or (kind == EXIT and running.get(cpu, (None,))[0] == pid):
+            if cpu in running:
+                rpid, start, args = running.pop(cpu)
+                args["end"] = NAMES[kind]
+                out.append({"name": "PID %d" % rpid, "ph": "X", "pid": 0, "tid": cpu,
+                            "ts": start, "dur": t - start, "args": args})
+            if kind == YIELD:
+                ready_at[pid] = t
+        else:
+            args = {"pid": pid}
+            if kind in (WAKE, CREATE):
+                args["by"] = signed(arg)
+                ready_at[pid] = t
+            elif kind == SEND:
+                args["to"] = arg
+            elif kind == RECV:
+                args["got_message"] = bool(arg)
+            elif kind == ALLOC_FAIL:
+                args["bytes"] = arg
+            out.append({"name": NAMES.get(kind, str(kind)), "ph": "i", "s": "t",
+                        "pid": 0, "tid": cpu, "ts": t, "args": args})
+            if kind == WAKE:
+                out.append({"name": "wake", "ph": "s", "id": next_flow,
+                            "pid": 0, "tid": cpu, "ts": t})
+                flows[pid] = next_flow
+                next_flow += 1
+
+    for cpu in range(1 + max(ev[2] for ev in events)):
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+                    "args": {"name": "CPU %d" % cpu}})
+    return out
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    data = open(sys.argv[1], "rb").read()
+    text = "--text" in sys.argv[2:]
+    dumps = list(traces(data))
+    if not dumps:
+        sys.exit("no trace found in %s" % sys.argv[1])
+
+    tsc_khz, events = dumps[-1]
+    if text:
+        base = events[0][0] if events else 0
+        for tsc, kind, cpu, pid, arg in events:
+            print("%12.3f us  cpu%d  pid %-3d %-10s %d" % (
+                (tsc - base) * 1000.0 / max(tsc_khz, 1), cpu, pid,
+                NAMES.get(kind, str(kind)), signed(arg)))
+        return
+    json.dump({"traceEvents": to_chrome(tsc_khz, events), "displayTimeUnit": "ns"},
+              sys.stdout, indent=1)
+
+
+if __name__ == "__main__":
+    main()